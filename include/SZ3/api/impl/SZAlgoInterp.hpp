@@ -3,6 +3,7 @@
 
 #include "SZ3/decomposition/InterpolationDecomposition.hpp"
 #include "SZ3/compressor/specialized/SZBlockInterpolationCompressor.hpp"
+#include "SZ3/compressor/SZProgressiveCompressor.hpp"
 #include "SZ3/quantizer/IntegerQuantizer.hpp"
 #include "SZ3/lossless/Lossless_zstd.hpp"
 #include "SZ3/utils/Iterator.hpp"
@@ -15,31 +16,65 @@
 #include <memory>
 
 namespace SZ3 {
+    /**
+     * @param strides layout of data (see Layout.hpp), interpolation reads strided data in place. Contiguous if empty.
+     */
     template<class T, uint N>
-    size_t SZ_compress_Interp(Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
+    size_t SZ_compress_Interp(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                              const std::vector<size_t> &strides = {}) {
         assert(N == conf.N);
         assert(conf.cmprAlgo == ALGO_INTERP);
-        calAbsErrorBound(conf, data);
+        calAbsErrorBound(conf, data, strides);
         
-        auto sz = make_compressor_sz_generic<T, N>(
-            make_decomposition_interpolation<T, N>(conf,
-                                                   LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2)),
-            HuffmanEncoder<int>(),
-            Lossless_zstd());
-        return sz->compress(conf, data, cmpData, cmpCap);
+        auto decomposition = make_decomposition_interpolation<T, N>(conf,
+                                                                    LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2));
+        decomposition.set_strides(strides);
+        if (conf.progressive) {
+            auto sz = make_compressor_sz_progressive<T, N>(decomposition, ctx.encoder, ctx.lossless, &ctx.buffer);
+            return sz->compress(conf, data, cmpData, cmpCap);
+        }
+        return with_encoder(conf, ctx.encoder, [&](auto encoder) {
+            auto sz = make_compressor_sz_generic<T, N>(decomposition, encoder, ctx.lossless, &ctx.buffer);
+            return sz->compress(conf, data, cmpData, cmpCap);
+        });
 //        return cmpData;
     }
     
+    /**
+     * decompress the interpolation levels of stride 2^level and coarser of data compressed with conf.progressive
+     * @param decData the points every 2^level along each dimension, or the full grid with upsample
+     * @param strides layout of decData when it gets the full grid (see Layout.hpp), contiguous if empty
+     */
+    template<class T, uint N>
+    void SZ_decompress_Interp_level(const Config &conf, const uchar *cmpData, size_t cmpSize, uint level, bool upsample,
+                                    T *decData, Context &ctx, const std::vector<size_t> &strides = {}) {
+        assert(conf.cmprAlgo == ALGO_INTERP && conf.progressive);
+        auto decomposition = make_decomposition_interpolation<T, N>(conf,
+                                                                    LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2));
+        decomposition.set_strides(strides);
+        auto sz = make_compressor_sz_progressive<T, N>(decomposition, ctx.encoder, ctx.lossless, &ctx.buffer);
+        sz->decompress_level(conf, cmpData, cmpSize, level, upsample, decData);
+    }
+    
+    /**
+     * @param strides layout of decData (see Layout.hpp), interpolation writes strided data in place. Contiguous if empty.
+     */
     template<class T, uint N>
-    void SZ_decompress_Interp(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData) {
+    void SZ_decompress_Interp(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData, Context &ctx,
+                              const std::vector<size_t> &strides = {}) {
         assert(conf.cmprAlgo == ALGO_INTERP);
+        if (conf.progressive) {
+            SZ_decompress_Interp_level<T, N>(conf, cmpData, cmpSize, 0, false, decData, ctx, strides);
+            return;
+        }
         auto cmpDataPos = cmpData;
-        auto sz = make_compressor_sz_generic<T, N>(
-            make_decomposition_interpolation<T, N>(conf,
-                                                   LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2)),
-            HuffmanEncoder<int>(),
-            Lossless_zstd());
-        sz->decompress(conf, cmpDataPos, cmpSize, decData);
+        auto decomposition = make_decomposition_interpolation<T, N>(conf,
+                                                                    LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2));
+        decomposition.set_strides(strides);
+        with_encoder(conf, ctx.encoder, [&](auto encoder) {
+            auto sz = make_compressor_sz_generic<T, N>(decomposition, encoder, ctx.lossless, &ctx.buffer);
+            sz->decompress(conf, cmpDataPos, cmpSize, decData);
+        });
     }
     
     template<class T, uint N>
@@ -65,20 +100,23 @@ namespace SZ3 {
         return compression_ratio;
     }
     
+    /**
+     * choose between interpolation and lorenzo on samples of the data, and tune the chosen one
+     * conf (with an absolute error bound) is turned into the tuned ALGO_INTERP or ALGO_LORENZO_REG configuration
+     * @param strides layout of data (see Layout.hpp), contiguous if empty
+     */
     template<class T, uint N>
-    size_t SZ_compress_Interp_lorenzo(Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
+    void SZ_tune_Interp_lorenzo(Config &conf, const T *data, Context &ctx, const std::vector<size_t> &strides = {}) {
         assert(conf.cmprAlgo == ALGO_INTERP_LORENZO);
         
 //        Timer timer(true);
         
-        calAbsErrorBound(conf, data);
-        
         size_t sampling_num, sampling_block;
         std::vector<size_t> sample_dims(N);
-        std::vector<T> sampling_data = sampling<T, N>(data, conf.dims, sampling_num, sample_dims, sampling_block);
+        std::vector<T> sampling_data = sampling<T, N>(data, conf.dims, sampling_num, sample_dims, sampling_block, strides);
         if (sampling_num == conf.num) {
             conf.cmprAlgo = ALGO_INTERP;
-            return SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap);
+            return;
         }
         
         double best_lorenzo_ratio = 0, best_interp_ratio = 0, ratio;
@@ -97,7 +135,7 @@ namespace SZ3 {
             lorenzo_config.blockSize = 5;
 //        lorenzo_config.quantbinCnt = 65536 * 2;
             std::vector<T> data1(sampling_data);
-            size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, data1.data(), buffer, bufferCap);
+            size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, data1.data(), buffer, bufferCap, ctx);
 //            delete[]cmprData;
 //    printf("Lorenzo ratio = %.2f\n", ratio);
             best_lorenzo_ratio = sampling_num * 1.0 * sizeof(T) / sampleOutSize;
@@ -124,19 +162,23 @@ namespace SZ3 {
         }
         
         bool useInterp = !(best_lorenzo_ratio > best_interp_ratio && best_lorenzo_ratio < 80 && best_interp_ratio < 80);
-        size_t cmpSize = 0;
         if (useInterp) {
             conf.cmprAlgo = ALGO_INTERP;
-            cmpSize = SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap);
         } else {
             //further tune lorenzo
             if (N == 3) {
                 float pred_freq, mean_freq;
                 T mean_guess;
-                lorenzo_config.quantbinCnt = optimize_quant_invl_3d<T>(data, conf.dims[0], conf.dims[1], conf.dims[2],
+                std::vector<T> packed;
+                if (!is_contiguous(conf.dims, strides)) {
+                    packed.resize(conf.num);
+                    pack(data, strides, packed.data(), conf.dims);
+                }
+                lorenzo_config.quantbinCnt = optimize_quant_invl_3d<T>(packed.empty() ? data : packed.data(),
+                                                                       conf.dims[0], conf.dims[1], conf.dims[2],
                                                                        conf.absErrorBound, pred_freq, mean_freq, mean_guess);
                 lorenzo_config.pred_dim = 2;
-                size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, sampling_data.data(), buffer, bufferCap);
+                size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, sampling_data.data(), buffer, bufferCap, ctx);
                 ratio = sampling_num * 1.0 * sizeof(T) / sampleOutSize;
                 if (ratio > best_lorenzo_ratio * 1.02) {
                     best_lorenzo_ratio = ratio;
@@ -148,7 +190,7 @@ namespace SZ3 {
             if (conf.relErrorBound < 1.01e-6 && best_lorenzo_ratio > 5 && lorenzo_config.quantbinCnt != 16384) {
                 auto quant_num = lorenzo_config.quantbinCnt;
                 lorenzo_config.quantbinCnt = 16384;
-                size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, sampling_data.data(), buffer, bufferCap);
+                size_t sampleOutSize = SZ_compress_LorenzoReg<T, N>(lorenzo_config, sampling_data.data(), buffer, bufferCap, ctx);
 //                delete[]cmprData;
                 ratio = sampling_num * 1.0 * sizeof(T) / sampleOutSize;
                 if (ratio > best_lorenzo_ratio * 1.02) {
@@ -160,11 +202,31 @@ namespace SZ3 {
             lorenzo_config.setDims(conf.dims.begin(), conf.dims.end());
             conf = lorenzo_config;
 //            double tuning_time = timer.stop();
-            cmpSize = SZ_compress_LorenzoReg<T, N>(conf, data, cmpData, cmpCap);
         }
         
         free(buffer);
-        return cmpSize;
+    }
+    
+    /**
+     * @param strides layout of data (see Layout.hpp), contiguous if empty. Lorenzo works on a contiguous copy.
+     */
+    template<class T, uint N>
+    size_t SZ_compress_Interp_lorenzo(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                                      const std::vector<size_t> &strides = {}) {
+        assert(conf.cmprAlgo == ALGO_INTERP_LORENZO);
+        
+        calAbsErrorBound(conf, data, strides);
+        
+        SZ_tune_Interp_lorenzo<T, N>(conf, data, ctx, strides);
+        if (conf.cmprAlgo == ALGO_INTERP) {
+            return SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+        } else if (is_contiguous(conf.dims, strides)) {
+            return SZ_compress_LorenzoReg<T, N>(conf, data, cmpData, cmpCap, ctx);
+        } else {
+            std::vector<T> packed(conf.num);
+            pack(data, strides, packed.data(), conf.dims);
+            return SZ_compress_LorenzoReg<T, N>(conf, packed.data(), cmpData, cmpCap, ctx);
+        }
     }
 }
 #endif
@@ -15,6 +15,7 @@
 #include "SZ3/utils/Extraction.hpp"
 #include "SZ3/utils/QuantOptimizatioin.hpp"
 #include "SZ3/utils/Config.hpp"
+#include "SZ3/utils/Context.hpp"
 #include "SZ3/def.hpp"
 #include <cmath>
 #include <memory>
@@ -22,7 +23,8 @@
 namespace SZ3 {
     template<class T, uint N, class Quantizer, class Encoder, class Lossless>
     std::shared_ptr<concepts::CompressorInterface<T>>
-    make_compressor_typetwo_lorenzo_regression(const Config &conf, Quantizer quantizer, Encoder encoder, Lossless lossless) {
+    make_compressor_typetwo_lorenzo_regression(const Config &conf, Quantizer quantizer, Encoder encoder, Lossless lossless,
+                                               std::vector<uchar> *buffer = nullptr) {
         std::vector<std::shared_ptr<concepts::PredictorInterface<T, N>>> predictors;
 
         int methodCnt = (conf.lorenzo + conf.lorenzo2 + conf.regression + conf.regression2);
@@ -35,7 +37,7 @@ namespace SZ3 {
             if (use_single_predictor) {
                 return make_compressor_sz_iterate<T, N>(conf,
                                                         LorenzoPredictor<T, N, 1>(conf.absErrorBound),
-                                                        quantizer, encoder, lossless);
+                                                        quantizer, encoder, lossless, buffer);
             } else {
                 predictors.push_back(std::make_shared<LorenzoPredictor<T, N, 1>>(conf.absErrorBound));
             }
@@ -44,7 +46,7 @@ namespace SZ3 {
             if (use_single_predictor) {
                 return make_compressor_sz_iterate<T, N>(conf,
                                                         LorenzoPredictor<T, N, 2>(conf.absErrorBound),
-                                                        quantizer, encoder, lossless);
+                                                        quantizer, encoder, lossless, buffer);
             } else {
                 predictors.push_back(std::make_shared<LorenzoPredictor<T, N, 2>>(conf.absErrorBound));
             }
@@ -52,7 +54,7 @@ namespace SZ3 {
         if (conf.regression) {
             if (use_single_predictor) {
                 return make_compressor_sz_iterate<T, N>(conf, RegressionPredictor<T, N>(conf.blockSize, conf.absErrorBound),
-                                                        quantizer, encoder, lossless);
+                                                        quantizer, encoder, lossless, buffer);
             } else {
                 predictors.push_back(std::make_shared<RegressionPredictor<T, N>>(conf.blockSize, conf.absErrorBound));
             }
@@ -61,18 +63,18 @@ namespace SZ3 {
         if (conf.regression2) {
             if (use_single_predictor) {
                 return make_compressor_sz_iterate<T, N>(conf, PolyRegressionPredictor<T, N>(conf.blockSize, conf.absErrorBound),
-                                                        quantizer, encoder, lossless);
+                                                        quantizer, encoder, lossless, buffer);
             } else {
                 predictors.push_back(std::make_shared<PolyRegressionPredictor<T, N>>(conf.blockSize, conf.absErrorBound));
             }
         }
         return make_compressor_sz_iterate<T, N>(conf, ComposedPredictor<T, N>(predictors),
-                                                quantizer, encoder, lossless);
+                                                quantizer, encoder, lossless, buffer);
     }
 
 
     template<class T, uint N>
-    size_t SZ_compress_LorenzoReg(Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
+    size_t SZ_compress_LorenzoReg(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx) {
 
         assert(N == conf.N);
         assert(conf.cmprAlgo == ALGO_LORENZO_REG);
@@ -81,32 +83,39 @@ namespace SZ3 {
         auto quantizer = LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2);
         if (N == 3 && !conf.regression2 || (N == 1 && !conf.regression && !conf.regression2)) {
             // use fast version for 3D
-            auto sz = make_compressor_sz_generic<T, N>(make_decomposition_lorenzo_regression<T, N>(conf, quantizer), HuffmanEncoder<int>(),
-                                                       Lossless_zstd());
-            return sz->compress(conf, data, cmpData, cmpCap);
+            return with_encoder(conf, ctx.encoder, [&](auto encoder) {
+                auto sz = make_compressor_sz_generic<T, N>(make_decomposition_lorenzo_regression<T, N>(conf, quantizer),
+                                                           encoder, ctx.lossless, &ctx.buffer);
+                return sz->compress(conf, data, cmpData, cmpCap);
+            });
         } else {
-            auto sz = make_compressor_typetwo_lorenzo_regression<T, N>(conf, quantizer, HuffmanEncoder<int>(), Lossless_zstd());
-            return sz->compress(conf, data, cmpData, cmpCap);
+            // the iterate compressor overwrites its input with the reconstructed values
+            std::vector<T> dataCopy(data, data + conf.num);
+            auto sz = make_compressor_typetwo_lorenzo_regression<T, N>(conf, quantizer, ctx.encoder, ctx.lossless, &ctx.buffer);
+            return sz->compress(conf, dataCopy.data(), cmpData, cmpCap);
         }
 //        return cmpData;
     }
 
 
     template<class T, uint N>
-    void SZ_decompress_LorenzoReg(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData) {
+    void SZ_decompress_LorenzoReg(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData, Context &ctx) {
         assert(conf.cmprAlgo == ALGO_LORENZO_REG);
 
         auto cmpDataPos = cmpData;
-        LinearQuantizer<T> quantizer;
+        // same radius as in compression, the decompression buffer is sized from it
+        auto quantizer = LinearQuantizer<T>(conf.absErrorBound, conf.quantbinCnt / 2);
         if (N == 3 && !conf.regression2 || (N == 1 && !conf.regression && !conf.regression2)) {
             // use fast version for 3D
-            auto sz = make_compressor_sz_generic<T, N>(make_decomposition_lorenzo_regression<T, N>(conf, quantizer),
-                                                       HuffmanEncoder<int>(), Lossless_zstd());
-            sz->decompress(conf, cmpDataPos, cmpSize, decData);
+            with_encoder(conf, ctx.encoder, [&](auto encoder) {
+                auto sz = make_compressor_sz_generic<T, N>(make_decomposition_lorenzo_regression<T, N>(conf, quantizer),
+                                                           encoder, ctx.lossless, &ctx.buffer);
+                sz->decompress(conf, cmpDataPos, cmpSize, decData);
+            });
             return;
 
         } else {
-            auto sz = make_compressor_typetwo_lorenzo_regression<T, N>(conf, quantizer, HuffmanEncoder<int>(), Lossless_zstd());
+            auto sz = make_compressor_typetwo_lorenzo_regression<T, N>(conf, quantizer, ctx.encoder, ctx.lossless, &ctx.buffer);
             sz->decompress(conf, cmpDataPos, cmpSize, decData);
             return;
         }
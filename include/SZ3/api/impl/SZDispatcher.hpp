@@ -4,47 +4,106 @@
 #include "SZ3/utils/MemoryUtil.hpp"
 #include "SZ3/utils/Statistic.hpp"
 #include "SZ3/utils/Config.hpp"
+#include "SZ3/utils/Context.hpp"
 #include "SZ3/api/impl/SZAlgoInterp.hpp"
 #include "SZ3/api/impl/SZAlgoLorenzoReg.hpp"
 #include "SZ3/api/impl/SZAlgo.hpp"
 #include <cmath>
+#include <stdexcept>
 
 namespace SZ3 {
+    /**
+     * compress data with the lossy algorithm of conf, conf.absErrorBound != 0
+     * @param strides layout of data (see Layout.hpp), contiguous if empty.
+     * Interpolation reads strided data in place, the other algorithms compress a contiguous copy.
+     */
     template<class T, uint N>
-    size_t SZ_compress_dispatcher(Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
-        
-        assert(N == conf.N);
-        calAbsErrorBound(conf, data);
+    size_t SZ_compress_lossy_dispatcher(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                                        const std::vector<size_t> &strides = {}) {
+        if (!is_contiguous(conf.dims, strides)) {
+            if (conf.cmprAlgo == ALGO_INTERP) {
+                return SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+            } else if (conf.cmprAlgo == ALGO_INTERP_LORENZO) {
+                return SZ_compress_Interp_lorenzo<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+            }
+            std::vector<T> packed(conf.num);
+            pack(data, strides, packed.data(), conf.dims);
+            return SZ_compress_lossy_dispatcher<T, N>(conf, packed.data(), cmpData, cmpCap, ctx);
+        }
 
-//        char *cmpData;
-        if (conf.absErrorBound == 0) {
-            auto zstd = Lossless_zstd();
-            return zstd.compress((uchar *) data, conf.num * sizeof(T), cmpData, cmpCap);
-        } else if (conf.cmprAlgo == ALGO_LORENZO_REG) {
-            return SZ_compress_LorenzoReg<T, N>(conf, data, cmpData, cmpCap);
+        if (conf.cmprAlgo == ALGO_LORENZO_REG) {
+            return SZ_compress_LorenzoReg<T, N>(conf, data, cmpData, cmpCap, ctx);
         } else if (conf.cmprAlgo == ALGO_INTERP) {
-            return SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap);
+            return SZ_compress_Interp<T, N>(conf, data, cmpData, cmpCap, ctx);
         } else if (conf.cmprAlgo == ALGO_INTERP_LORENZO) {
-            return SZ_compress_Interp_lorenzo<T, N>(conf, data, cmpData, cmpCap);
+            return SZ_compress_Interp_lorenzo<T, N>(conf, data, cmpData, cmpCap, ctx);
         } else if (conf.cmprAlgo == ALGO_NOPRED) {
-            return SZ_compress_nopred<T, N>(conf, data, cmpData, cmpCap);
+            return SZ_compress_nopred<T, N>(conf, data, cmpData, cmpCap, ctx);
         }
         return 0;
-//        return cmpData;
+    }
+
+    /**
+     * Data is stored by the lossless module alone if the error bound is 0, or if the lossy data does not fit cmpCap
+     * (which is then below SZ_compress_bound_dispatcher). CapacityError is thrown if that does not fit either.
+     * @param strides layout of data (see Layout.hpp), contiguous if empty
+     */
+    template<class T, uint N>
+    size_t SZ_compress_dispatcher(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                                  const std::vector<size_t> &strides = {}) {
+        
+        assert(N == conf.N);
+        ctx.lossless.set_params(conf.zstdLevel, conf.zstdWorkers, conf.lossless);
+        calAbsErrorBound(conf, data, strides);
+        if (conf.absErrorBound != 0) {
+            try {
+                return SZ_compress_lossy_dispatcher<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+            } catch (CapacityError &) {
+                conf.absErrorBound = 0;
+            }
+        }
+
+        if (!is_contiguous(conf.dims, strides)) {
+            std::vector<T> packed(conf.num);
+            pack(data, strides, packed.data(), conf.dims);
+            return ctx.lossless.compress((uchar *) packed.data(), conf.num * sizeof(T), cmpData, cmpCap);
+        }
+        return ctx.lossless.compress((uchar *) data, conf.num * sizeof(T), cmpData, cmpCap);
     }
     
+    // worst-case size of SZ_compress_dispatcher: the size of the data stored as is, as larger lossy data is not kept
     template<class T, uint N>
-    void SZ_decompress_dispatcher(Config &conf, const uchar *cmpData, size_t cmpSize, T *decData) {
+    size_t SZ_compress_bound_dispatcher(const Config &conf) {
+        return Lossless_zstd().size_bound(conf.num * sizeof(T));
+    }
+    
+    /**
+     * @param strides layout of decData (see Layout.hpp), contiguous if empty.
+     * Interpolation writes strided data in place, the other algorithms decompress to a contiguous copy first.
+     */
+    template<class T, uint N>
+    void SZ_decompress_dispatcher(Config &conf, const uchar *cmpData, size_t cmpSize, T *decData, Context &ctx,
+                                  const std::vector<size_t> &strides = {}) {
+        LegacyHuffmanFormat huffmanFormat(conf.legacy_format());
+        if (!is_contiguous(conf.dims, strides)) {
+            if (conf.absErrorBound != 0 && conf.cmprAlgo == ALGO_INTERP) {
+                SZ_decompress_Interp<T, N>(conf, cmpData, cmpSize, decData, ctx, strides);
+            } else {
+                std::vector<T> packed(conf.num);
+                SZ_decompress_dispatcher<T, N>(conf, cmpData, cmpSize, packed.data(), ctx);
+                unpack(packed.data(), decData, strides, conf.dims);
+            }
+            return;
+        }
         if (conf.absErrorBound == 0) {
-            auto zstd = Lossless_zstd();
             auto zstdDstCap = conf.num * sizeof(T);
-            zstd.decompress(cmpData, cmpSize, (uchar *) decData, zstdDstCap);
+            ctx.lossless.decompress(cmpData, cmpSize, (uchar *) decData, zstdDstCap);
         } else if (conf.cmprAlgo == ALGO_LORENZO_REG) {
-            SZ_decompress_LorenzoReg<T, N>(conf, cmpData, cmpSize, decData);
+            SZ_decompress_LorenzoReg<T, N>(conf, cmpData, cmpSize, decData, ctx);
         } else if (conf.cmprAlgo == ALGO_INTERP) {
-            SZ_decompress_Interp<T, N>(conf, cmpData, cmpSize, decData);
+            SZ_decompress_Interp<T, N>(conf, cmpData, cmpSize, decData, ctx);
         } else if (conf.cmprAlgo == ALGO_NOPRED) {
-            SZ_decompress_nopred<T, N>(conf, cmpData, cmpSize, decData);
+            SZ_decompress_nopred<T, N>(conf, cmpData, cmpSize, decData, ctx);
         } else {
             printf("SZ_decompress_dispatcher, Method not supported\n");
             exit(0);
@@ -4,35 +4,157 @@
 #include "SZ3/def.hpp"
 #include "SZ3/api/impl/SZDispatcher.hpp"
 #include "SZ3/api/impl/SZImplOMP.hpp"
+#include "SZ3/api/impl/SZImplTiled.hpp"
 #include <cmath>
+#include <stdexcept>
 
 namespace SZ3 {
+    /**
+     * @param strides layout of data (see Layout.hpp), contiguous if empty
+     */
     template<class T, uint N>
-    size_t SZ_compress_impl(Config &conf, const T *data, uchar *cmpData, size_t cmpCap) {
+    size_t SZ_compress_impl(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                            const std::vector<size_t> &strides = {}) {
 #ifndef _OPENMP
         conf.openmp=false;
 #endif
+        if (conf.tileSize > 0) {
+            //tiles are compressed in parallel if openmp is on
+            return SZ_compress_tiled<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+        }
         if (conf.openmp) {
-            //dataCopy for openMP is handled by each thread
-            return SZ_compress_OMP<T, N>(conf, data, cmpData, cmpCap);
+            //each thread compresses its blocks from data in place
+            try {
+                return SZ_compress_OMP<T, N>(conf, data, cmpData, cmpCap, strides);
+            } catch (CapacityError &) {
+                //the blocks and their headers do not fit cmpCap (below SZ_compress_bound_impl), the data is compressed in one piece
+                conf.openmp = false;
+            }
+        }
+        //the decompositions keep reconstructed values in their own scratch space, no full copy of data is needed
+        return SZ_compress_dispatcher<T, N>(conf, data, cmpData, cmpCap, ctx, strides);
+    }
+
+
+    /**
+     * run the tuning of the algorithm once, so that its result can be applied to other data of the same kind
+     * conf gets the tuned algorithm and settings, and the absolute error bound derived from data
+     */
+    template<class T, uint N>
+    void SZ_tune_impl(Config &conf, const T *data, Context &ctx) {
+        if (conf.cmprAlgo == ALGO_INTERP_LORENZO) {
+            calAbsErrorBound(conf, data);
+            if (conf.absErrorBound != 0) {
+                SZ_tune_Interp_lorenzo<T, N>(conf, data, ctx);
+            }
+        }
+    }
+
+
+    // OpenMP data that would not fit is compressed in one piece, so its bound does not depend on the number of threads
+    template<class T, uint N>
+    size_t SZ_compress_bound_impl(Config &conf) {
+        if (conf.tileSize > 0) {
+            return SZ_compress_tiled_bound<T, N>(conf);
+        }
+        return SZ_compress_bound_dispatcher<T, N>(conf);
+    }
+
+
+    /**
+     * @param strides layout of decData (see Layout.hpp), contiguous if empty
+     */
+    template<class T, uint N>
+    void SZ_decompress_impl(Config &conf, const uchar *cmpData, size_t cmpSize, T *decData, Context &ctx,
+                            const std::vector<size_t> &strides = {}) {
+
+
+#ifndef _OPENMP
+        conf.openmp=false;
+#endif
+        if (conf.tileSize > 0) {
+            SZ_decompress_tiled<T, N>(conf, cmpData, cmpSize, decData, ctx, strides);
+        } else if (conf.openmp) {
+            SZ_decompress_OMP<T, N>(conf, cmpData, cmpSize, decData, strides);
         } else {
-            std::vector<T> dataCopy(data, data + conf.num);
-            return SZ_compress_dispatcher<T, N>(conf, dataCopy.data(), cmpData, cmpCap);
+            SZ_decompress_dispatcher<T, N>(conf, cmpData, cmpSize, decData, ctx, strides);
         }
     }
 
 
+    /**
+     * decompress the box [lo, hi) into decData (of shape hi - lo)
+     * only the overlapping tiles are decoded for tiled data, other data is decompressed in full and cropped
+     */
     template<class T, uint N>
-    void SZ_decompress_impl(Config &conf, const uchar *cmpData, size_t cmpSize, T *decData) {
+    void SZ_decompress_region_impl(Config &conf, const uchar *cmpData, size_t cmpSize,
+                                   const std::vector<size_t> &lo, const std::vector<size_t> &hi, T *decData, Context &ctx) {
+#ifndef _OPENMP
+        conf.openmp=false;
+#endif
+        std::vector<size_t> regionDims(N);
+        for (uint d = 0; d < N; d++) {
+            regionDims[d] = hi[d] - lo[d];
+        }
+        if (conf.tileSize > 0) {
+            SZ_decompress_tiled_region<T, N>(conf, cmpData, cmpSize, lo, hi, decData, ctx);
+        } else {
+            std::vector<T> full(conf.num);
+            SZ_decompress_impl<T, N>(conf, cmpData, cmpSize, full.data(), ctx);
+            copy_box(full.data(), contiguous_strides(conf.dims), lo, decData, contiguous_strides(regionDims), std::vector<size_t>(N, 0), regionDims);
+        }
+    }
+
+
+    // shape of the data at a lower resolution: the points every 2^level along each dimension
+    inline std::vector<size_t> level_dims(const std::vector<size_t> &dims, uint level) {
+        std::vector<size_t> ldims(dims.size());
+        for (size_t d = 0; d < dims.size(); d++) {
+            ldims[d] = level < 8 * sizeof(size_t) ? ((dims[d] - 1) >> level) + 1 : 1;
+        }
+        return ldims;
+    }
 
 
+    /**
+     * decompress the data at a lower resolution into decData, of shape level_dims(conf.dims, level),
+     * or of shape conf.dims with upsample, where the points in between are predicted from the decoded ones.
+     * Only the coarse interpolation levels are read and decoded if the data was compressed with conf.progressive,
+     * other data is decompressed in full and subsampled (with upsample, returned as is).
+     */
+    template<class T, uint N>
+    void SZ_decompress_level_impl(Config &conf, const uchar *cmpData, size_t cmpSize, uint level, bool upsample,
+                                  T *decData, Context &ctx) {
 #ifndef _OPENMP
         conf.openmp=false;
 #endif
-        if (conf.openmp) {
-            SZ_decompress_OMP<T, N>(conf, cmpData, cmpSize, decData);
+        if (conf.progressive && conf.cmprAlgo == ALGO_INTERP && conf.absErrorBound != 0 && conf.tileSize == 0 && !conf.openmp) {
+            SZ_decompress_Interp_level<T, N>(conf, cmpData, cmpSize, level, upsample, decData, ctx);
+        } else if (upsample) {
+            SZ_decompress_impl<T, N>(conf, cmpData, cmpSize, decData, ctx);
         } else {
-            SZ_decompress_dispatcher<T, N>(conf, cmpData, cmpSize, decData);
+            std::vector<T> full(conf.num);
+            SZ_decompress_impl<T, N>(conf, cmpData, cmpSize, full.data(), ctx);
+            level = std::min<uint>(level, 8 * sizeof(size_t) - 1);
+            auto ldims = level_dims(conf.dims, level);
+            size_t lnum = 1;
+            for (auto dim: ldims) {
+                lnum *= dim;
+            }
+            std::vector<size_t> idx(N, 0);
+            for (size_t i = 0; i < lnum; i++) {
+                size_t offset = 0;
+                for (uint d = 0; d < N; d++) {
+                    offset = offset * conf.dims[d] + (idx[d] << level);
+                }
+                decData[i] = full[offset];
+                for (uint d = N; d-- > 0;) {
+                    if (++idx[d] < ldims[d]) {
+                        break;
+                    }
+                    idx[d] = 0;
+                }
+            }
         }
     }
 }
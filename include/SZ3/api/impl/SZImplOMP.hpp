@@ -2,8 +2,15 @@
 #define SZ3_IMPL_SZDISPATCHER_OMP_HPP
 
 #include "SZ3/api/impl/SZDispatcher.hpp"
+#include "SZ3/api/impl/SZImplTiled.hpp"
+#include "SZ3/utils/Layout.hpp"
+#include <algorithm>
 #include <cmath>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <numeric>
+#include <stdexcept>
 
 
 #ifdef _OPENMP
@@ -12,96 +19,171 @@
 
 #endif
 namespace SZ3 {
+
+    /**
+     * OpenMP format: the data is cut into blocks along all dimensions, one per thread unless conf.ompBlocks is set
+     * (see omp_block_counts), and every block is compressed on its own.
+     *
+     * Layout: the number of blocks along every dimension, the Config of every block (row-major block order),
+     * the compressed size of every block, then the compressed blocks.
+     * Data version 3.2.0 starts with the number of slabs along the first dimension (an int) instead.
+     */
+
+    /**
+     * number of blocks along every dimension to cut data of shape dims into nBlocks blocks of balanced size.
+     * The prime factors of nBlocks go, largest first, to the dimension with the longest block extent,
+     * so the blocks stay close to cubes whatever the shape. A factor is dropped if it does not fit anywhere,
+     * as blocks are at least 2 wide along every dimension.
+     */
+    inline std::vector<size_t> omp_block_counts(const std::vector<size_t> &dims, size_t nBlocks) {
+        std::vector<size_t> factors;
+        for (size_t p = 2; p * p <= nBlocks; p++) {
+            while (nBlocks % p == 0) {
+                factors.push_back(p);
+                nBlocks /= p;
+            }
+        }
+        if (nBlocks > 1) {
+            factors.push_back(nBlocks);
+        }
+        std::sort(factors.rbegin(), factors.rend());
+
+        std::vector<size_t> counts(dims.size(), 1);
+        for (auto p: factors) {
+            size_t best = dims.size();
+            for (size_t d = 0; d < dims.size(); d++) {
+                if (counts[d] * p * 2 <= dims[d] && (best == dims.size() || dims[d] / counts[d] > dims[best] / counts[best])) {
+                    best = d;
+                }
+            }
+            if (best < dims.size()) {
+                counts[best] *= p;
+            }
+        }
+        return counts;
+    }
+
+    // number of blocks of SZ_compress_OMP
+    inline size_t omp_num_blocks(const Config &conf) {
+#ifdef _OPENMP
+        return conf.ompBlocks > 0 ? conf.ompBlocks : omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    /**
+     * Every block is compressed straight from data into its own slot of cmpData, sized by the worst case of the block,
+     * then the blocks are moved down to follow each other. No copy of data is made, except for algorithms that need
+     * their input contiguous (see SZ_compress_dispatcher). If cmpCap leaves no room for the slots, every block is
+     * compressed into a buffer of its own instead, and CapacityError is thrown if the blocks do not fit cmpCap.
+     * @param strides layout of data (see Layout.hpp), contiguous if empty
+     */
     template<class T, uint N>
-    size_t SZ_compress_OMP(Config &conf, const T *data, uchar *cmpData, size_t cmpCap) {
+    size_t SZ_compress_OMP(Config &conf, const T *data, uchar *cmpData, size_t cmpCap,
+                           const std::vector<size_t> &strides = {}) {
         unsigned char *buffer_pos = cmpData;
 
 #ifdef _OPENMP
 
         assert(N == conf.N);
 
-        std::vector<uchar *> compressed_t;
-        std::vector<size_t> cmp_size_t, cmp_start_t;
-        std::vector<T> min_t, max_t;
-        std::vector<Config> conf_t;
+        auto counts = omp_block_counts(conf.dims, omp_num_blocks(conf));
+        TileGrid grid(conf.dims, counts);
+        int nBlocks = grid.num;
+        auto dataStrides = strides.empty() ? contiguous_strides(conf.dims) : strides;
+        auto block_offset = [&](const std::vector<size_t> &start_t) {
+            size_t offset = 0;
+            for (uint d = 0; d < N; d++) {
+                offset += start_t[d] * dataStrides[d];
+            }
+            return offset;
+        };
 //    Timer timer(true);
-        int nThreads = 1;
-        double eb;
-#pragma omp parallel
-#pragma omp single
-        {
-            nThreads = omp_get_num_threads();
-        }
-        if (conf.dims[0] < nThreads) {
-            nThreads = conf.dims[0];
-            omp_set_num_threads(nThreads);
-        }
-//        printf("OpenMP threads = %d\n", nThreads);
-        compressed_t.resize(nThreads);
-        cmp_size_t.resize(nThreads + 1);
-        cmp_start_t.resize(nThreads + 1);
-        conf_t.resize(nThreads);
-        min_t.resize(nThreads);
-        max_t.resize(nThreads);
-#pragma omp parallel
-        {
 
-            int tid = omp_get_thread_num();
-
-            auto dims_t = conf.dims;
-            int lo = tid * conf.dims[0] / nThreads;
-            int hi = (tid + 1) * conf.dims[0] / nThreads;
-            dims_t[0] = hi - lo;
-            auto it = dims_t.begin();
-            size_t num_t_base = std::accumulate(++it, dims_t.end(), (size_t) 1, std::multiplies<size_t>());
-            size_t num_t = dims_t[0] * num_t_base;
-
-//        T *data_t = data + lo * num_t_base;
-            std::vector<T> data_t(data + lo * num_t_base, data + lo * num_t_base + num_t);
-            if (conf.errorBoundMode != EB_ABS) {
-                auto minmax = std::minmax_element(data_t.begin(), data_t.end());
-                min_t[tid] = *minmax.first;
-                max_t[tid] = *minmax.second;
-#pragma omp barrier
-#pragma omp single
-                {
-                    T range = *std::max_element(max_t.begin(), max_t.end()) - *std::min_element(min_t.begin(), min_t.end());
-                    calAbsErrorBound<T>(conf, data, range);
-//                timer.stop("OMP init");
-//                timer.start();
-                }
+        if (conf.errorBoundMode != EB_ABS) {
+            std::vector<T> min_t(nBlocks), max_t(nBlocks);
+#pragma omp parallel for schedule(dynamic)
+            for (int id = 0; id < nBlocks; id++) {
+                std::vector<size_t> start_t, dims_t;
+                grid.tile(id, start_t, dims_t);
+                auto minmax = data_minmax(data + block_offset(start_t), dims_t, dataStrides);
+                min_t[id] = minmax.first;
+                max_t[id] = minmax.second;
             }
+            T range = *std::max_element(max_t.begin(), max_t.end()) - *std::min_element(min_t.begin(), min_t.end());
+            calAbsErrorBoundFromRange(conf, [&]() { return range; });
+//                timer.stop("OMP init");
+        }
 
-            conf_t[tid] = conf;
-            conf_t[tid].setDims(dims_t.begin(), dims_t.end());
-            cmp_size_t[tid] = data_t.size() * sizeof(T);
-            compressed_t[tid] = (uchar *) malloc(cmp_size_t[tid]);
-            SZ_compress_dispatcher<T, N>(conf_t[tid], data_t.data(), compressed_t[tid], cmp_size_t[tid]);
+        // slot of every block, after room for the header
+        std::vector<Config> conf_t(nBlocks);
+        std::vector<size_t> cmp_size_t(nBlocks), slot_t(nBlocks + 1);
+        slot_t[0] = N * sizeof(size_t) + nBlocks * (Config::size_est() + sizeof(size_t));
+        for (int id = 0; id < nBlocks; id++) {
+            std::vector<size_t> start_t, dims_t;
+            grid.tile(id, start_t, dims_t);
+            conf_t[id] = conf;
+            conf_t[id].setDims(dims_t.begin(), dims_t.end());
+            slot_t[id + 1] = slot_t[id] + SZ_compress_bound_dispatcher<T, N>(conf_t[id]);
+        }
+        bool inPlace = slot_t[nBlocks] <= cmpCap;
+        std::vector<std::vector<uchar>> cmpData_t(inPlace ? 0 : nBlocks);
 
-#pragma omp barrier
-#pragma omp single
-            {
-//            timer.stop("OMP compression");
-//            timer.start();
-                cmp_start_t[0] = 0;
-                for (int i = 1; i <= nThreads; i++) {
-                    cmp_start_t[i] = cmp_start_t[i - 1] + cmp_size_t[i - 1];
-                }
-                size_t bufferSize = sizeof(int) + (nThreads + 1) * Config::size_est() + cmp_start_t[nThreads];
-//                buffer = new uchar[bufferSize];
-//                buffer_pos = buffer;
-                write(nThreads, buffer_pos);
-                for (int i = 0; i < nThreads; i++) {
-                    conf_t[i].save(buffer_pos);
+        // blocks are taken by the threads one at a time, so a thread done with an easy block goes on with the next one
+        std::exception_ptr error;
+#pragma omp parallel
+        {
+            Context ctx_t;
+            std::vector<uchar> buffer_t;
+            std::vector<size_t> start_t, dims_t;
+#pragma omp for schedule(dynamic)
+            for (int id = 0; id < nBlocks; id++) {
+                try {
+                    grid.tile(id, start_t, dims_t);
+                    size_t cap = slot_t[id + 1] - slot_t[id];
+                    if (inPlace) {
+                        cmp_size_t[id] = SZ_compress_dispatcher<T, N>(conf_t[id], data + block_offset(start_t), cmpData + slot_t[id],
+                                                                      cap, ctx_t, dataStrides);
+                    } else {
+                        buffer_t.resize(std::max(buffer_t.size(), cap));
+                        cmp_size_t[id] = SZ_compress_dispatcher<T, N>(conf_t[id], data + block_offset(start_t), buffer_t.data(),
+                                                                      cap, ctx_t, dataStrides);
+                        cmpData_t[id].assign(buffer_t.begin(), buffer_t.begin() + cmp_size_t[id]);
+                    }
+                } catch (...) {
+#pragma omp critical
+                    if (!error) {
+                        error = std::current_exception();
+                    }
                 }
-                write(cmp_size_t.data(), nThreads, buffer_pos);
             }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+//            timer.stop("OMP compression");
 
-            memcpy(buffer_pos + cmp_start_t[tid], compressed_t[tid], cmp_size_t[tid]);
-            free(compressed_t[tid]);
+        size_t cmpSize = slot_t[0];
+        for (int id = 0; id < nBlocks; id++) {
+            cmpSize += cmp_size_t[id];
         }
-        
-        return buffer_pos - cmpData + cmp_start_t[nThreads];
+        if (cmpSize > cmpCap) {
+            throw CapacityError("cmpCap too small for the blocks of the OpenMP compression");
+        }
+
+        write(counts.data(), N, buffer_pos);
+        for (int i = 0; i < nBlocks; i++) {
+            conf_t[i].save(buffer_pos);
+        }
+        write(cmp_size_t.data(), nBlocks, buffer_pos);
+
+        // every block moves down, never past the start of its own slot, so it only overwrites free space
+        for (int id = 0; id < nBlocks; id++) {
+            memmove(buffer_pos, inPlace ? cmpData + slot_t[id] : cmpData_t[id].data(), cmp_size_t[id]);
+            buffer_pos += cmp_size_t[id];
+        }
+        return buffer_pos - cmpData;
 //    timer.stop("OMP memcpy");
 
 #endif
@@ -110,43 +192,112 @@ namespace SZ3 {
     }
 
 
+    /**
+     * the blocks are decompressed by the threads of this machine, taking one block at a time,
+     * so the number of threads does not depend on the number of blocks written by SZ_compress_OMP
+     * @param strides layout of decData (see Layout.hpp), contiguous if empty
+     */
     template<class T, uint N>
-    void SZ_decompress_OMP(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData) {
+    void SZ_decompress_OMP(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData,
+                           const std::vector<size_t> &strides = {}) {
 #ifdef _OPENMP
 
         auto cmpr_data_pos = cmpData;
-        int nThreads = 1;
-        read(nThreads, cmpr_data_pos);
-        omp_set_num_threads(nThreads);
-//    printf("OpenMP threads = %d\n", nThreads);
+        std::vector<size_t> counts(N, 1);
+        if (conf.legacy_format()) {
+            // data version 3.2.0: the number of blocks, along the first dimension
+            int blocks;
+            if (cmpSize < sizeof(blocks)) {
+                throw std::invalid_argument("cmpSize too small for the number of blocks");
+            }
+            read(blocks, cmpr_data_pos);
+            counts[0] = blocks < 0 ? 0 : blocks;
+        } else {
+            if (cmpSize < N * sizeof(size_t)) {
+                throw std::invalid_argument("cmpSize too small for the number of blocks");
+            }
+            read(counts.data(), N, cmpr_data_pos);
+        }
+        size_t num = 1;
+        for (uint d = 0; d < N; d++) {
+            if (counts[d] == 0 || counts[d] > conf.dims[d]) {
+                throw std::invalid_argument("number of blocks out of the range of the dimensions");
+            }
+            num *= counts[d];
+        }
+        // a Config (of at most Config::size_est() bytes) and a size per block
+        if (num > cmpSize / sizeof(size_t)) {
+            throw std::invalid_argument("cmpSize too small for the block headers");
+        }
+        TileGrid grid(conf.dims, counts);
+        int nBlocks = grid.num;
 
-        std::vector<Config> conf_t(nThreads);
-        for (int i = 0; i < nThreads; i++) {
-            conf_t[i].load(cmpr_data_pos);
+        std::vector<Config> conf_t(nBlocks);
+        for (int i = 0; i < nBlocks; i++) {
+            size_t remaining = cmpSize - (cmpr_data_pos - cmpData);
+            if (remaining >= Config::size_est()) {
+                conf_t[i].load(cmpr_data_pos);
+            } else {
+                // the last Configs are read from a padded copy, so that a truncated header is not read past its end
+                std::vector<uchar> padded(Config::size_est(), 0);
+                std::copy_n(cmpr_data_pos, remaining, padded.begin());
+                const uchar *pos = padded.data();
+                conf_t[i].load(pos);
+                if ((size_t) (pos - padded.data()) > remaining) {
+                    throw std::invalid_argument("cmpSize too small for the block headers");
+                }
+                cmpr_data_pos += pos - padded.data();
+            }
         }
 
+        if (nBlocks * sizeof(size_t) > cmpSize - (cmpr_data_pos - cmpData)) {
+            throw std::invalid_argument("cmpSize too small for the block headers");
+        }
         std::vector<size_t> cmp_start_t, cmp_size_t;
-        cmp_size_t.resize(nThreads);
-        read(cmp_size_t.data(), nThreads, cmpr_data_pos);
+        cmp_size_t.resize(nBlocks);
+        read(cmp_size_t.data(), nBlocks, cmpr_data_pos);
+        cmpSize -= cmpr_data_pos - cmpData;
         auto cmpr_data_p = cmpr_data_pos;
 
-        cmp_start_t.resize(nThreads + 1);
+        cmp_start_t.resize(nBlocks + 1);
         cmp_start_t[0] = 0;
-        for (int i = 1; i <= nThreads; i++) {
+        for (int i = 1; i <= nBlocks; i++) {
+            if (cmp_size_t[i - 1] > cmpSize - cmp_start_t[i - 1]) {
+                throw std::invalid_argument("block size out of the range of the compressed data");
+            }
             cmp_start_t[i] = cmp_start_t[i - 1] + cmp_size_t[i - 1];
         }
 
+        // every block is decompressed in place, with the strides of the whole data
+        auto decStrides = strides.empty() ? contiguous_strides(conf.dims) : strides;
+        std::exception_ptr error;
 #pragma omp parallel
         {
-            int tid = omp_get_thread_num();
-            auto dims_t = conf.dims;
-            int lo = tid * conf.dims[0] / nThreads;
-            int hi = (tid + 1) * conf.dims[0] / nThreads;
-            dims_t[0] = hi - lo;
-            auto it = dims_t.begin();
-            size_t num_t_base = std::accumulate(++it, dims_t.end(), (size_t) 1, std::multiplies<size_t>());
-
-            SZ_decompress_dispatcher<T, N>(conf_t[tid], cmpr_data_p + cmp_start_t[tid], cmp_size_t[tid], decData + lo * num_t_base);
+            Context ctx_t;
+            std::vector<size_t> start_t, dims_t;
+#pragma omp for schedule(dynamic)
+            for (int id = 0; id < nBlocks; id++) {
+                try {
+                    grid.tile(id, start_t, dims_t);
+                    if (conf_t[id].N != N || conf_t[id].dims != dims_t || conf_t[id].num != std::accumulate(dims_t.begin(), dims_t.end(), (size_t) 1, std::multiplies<size_t>())) {
+                        throw std::invalid_argument("block shape does not match the block grid");
+                    }
+                    size_t offset = 0;
+                    for (uint d = 0; d < N; d++) {
+                        offset += start_t[d] * decStrides[d];
+                    }
+                    SZ_decompress_dispatcher<T, N>(conf_t[id], cmpr_data_p + cmp_start_t[id], cmp_size_t[id], decData + offset, ctx_t,
+                                                   decStrides);
+                } catch (...) {
+#pragma omp critical
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
         }
 #endif
     }
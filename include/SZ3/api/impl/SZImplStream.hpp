@@ -0,0 +1,262 @@
+#ifndef SZ3_IMPL_SZSTREAM_HPP
+#define SZ3_IMPL_SZSTREAM_HPP
+
+#include "SZ3/def.hpp"
+#include "SZ3/api/impl/SZImpl.hpp"
+#include "SZ3/utils/Config.hpp"
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace SZ3 {
+
+    /**
+     * StreamCompressor compresses a field that does not fit in memory.
+     * The field is pushed slab by slab along dims[0] (the slowest dimension), buffered in a window of
+     * windowRows rows, and every full window is compressed into an independent frame handed to the sink.
+     * Each frame is the size of its SZ3 stream (size_t) followed by that stream, so the concatenated frames
+     * can be split again by StreamDecompressor. The bytes after the size_t prefix are a standalone SZ3 stream,
+     * which SZ_decompress turns into the rows of that window in order.
+     *
+     * Peak memory is bounded by the window (plus the compressed frame), not by the size of the field.
+     * Error bounds are evaluated per frame: ABS is exact, while REL, ABS_AND_REL and ABS_OR_REL use the value range
+     * of the frame, which is never larger than the global range and therefore never looser.
+     * PSNR and NORM depend on the whole field and are not supported.
+     *
+     * example:
+     * SZ3::Config conf(nt, ny, nx);
+     * conf.absErrorBound = 1e-3;
+     * SZ3::StreamCompressor<float, 3> stream(conf, 64, [&](const char *frame, size_t frameSize) {
+     *     write(frame, frameSize);
+     * });
+     * for (size_t t = 0; t < nt; t++) {
+     *     stream.push(slice(t), 1);
+     * }
+     * stream.finish();
+     *
+     * @tparam T source data type
+     * @tparam N number of dimensions of the whole field
+     */
+    template<class T, uint N>
+    class StreamCompressor {
+    public:
+        typedef std::function<void(const char *frame, size_t frameSize)> Sink;
+
+        /**
+         * @param conf configuration of the whole field, dims[0] is the total number of rows to be pushed
+         * @param windowRows number of rows along dims[0] compressed together in one frame
+         * @param sink callback receiving each compressed frame, the frame memory is reused after the callback returns
+         */
+        StreamCompressor(const Config &conf, size_t windowRows, Sink sink) :
+                conf(conf), windowRows(windowRows), sink(std::move(sink)) {
+            if (this->conf.N != N) {
+                throw std::invalid_argument("StreamCompressor dimension mismatch with the configuration");
+            }
+            if (windowRows == 0) {
+                throw std::invalid_argument("StreamCompressor window should contain at least one row");
+            }
+            if (conf.errorBoundMode == EB_PSNR || conf.errorBoundMode == EB_L2NORM) {
+                throw std::invalid_argument("StreamCompressor does not support PSNR or NORM error bound");
+            }
+            rowSize = conf.num / conf.dims[0];
+            this->windowRows = std::min(windowRows, conf.dims[0]);
+            window.resize(this->windowRows * rowSize);
+        }
+
+        /**
+         * append rows to the stream, frames are emitted whenever the window is full
+         * @param slab contiguous rows (rows * dims[1] * ... * dims[N-1] values)
+         * @param rows number of rows along dims[0] in slab
+         */
+        void push(const T *slab, size_t rows) {
+            if (finished) {
+                throw std::invalid_argument("StreamCompressor already finished");
+            }
+            if (rowsPushed + rows > conf.dims[0]) {
+                throw std::invalid_argument("StreamCompressor received more rows than dims[0]");
+            }
+            rowsPushed += rows;
+            while (rows > 0) {
+                size_t r = std::min(rows, windowRows - rowsBuffered);
+                std::copy(slab, slab + r * rowSize, window.begin() + rowsBuffered * rowSize);
+                slab += r * rowSize;
+                rows -= r;
+                rowsBuffered += r;
+                if (rowsBuffered == windowRows) {
+                    flush();
+                }
+            }
+        }
+
+        /**
+         * compress the remaining rows in the window, no more rows can be pushed afterwards
+         */
+        void finish() {
+            if (!finished) {
+                flush();
+                finished = true;
+            }
+        }
+
+        size_t get_window_rows() const { return windowRows; }
+
+        size_t get_frame_count() const { return frameCount; }
+
+        size_t get_compressed_size() const { return compressedSize; }
+
+    private:
+        void flush() {
+            if (rowsBuffered == 0) {
+                return;
+            }
+            auto dims = conf.dims;
+            dims[0] = rowsBuffered;
+            Config frameConf(conf);
+            frameConf.setDims(dims.begin(), dims.end());
+
+            size_t dstLen = 0;
+            if (frameConf.N == 1) {
+                dstLen = compress_frame<1>(frameConf);
+            } else if (frameConf.N == 2) {
+                dstLen = compress_frame<2>(frameConf);
+            } else if (frameConf.N == 3) {
+                dstLen = compress_frame<3>(frameConf);
+            } else if (frameConf.N == 4) {
+                dstLen = compress_frame<4>(frameConf);
+            }
+            size_t streamSize = Config::size_est() + dstLen;
+            auto headerPos = (uchar *) frame.data();
+            write(streamSize, headerPos);
+            frameConf.save(headerPos);
+
+            size_t frameSize = sizeof(size_t) + streamSize;
+            sink(frame.data(), frameSize);
+            compressedSize += frameSize;
+            frameCount++;
+            rowsBuffered = 0;
+        }
+
+        // frame size prefix and Config
+        static size_t header_size() { return sizeof(size_t) + Config::size_est(); }
+
+        // compress the window after the frame header, the frame buffer only grows to the largest bound seen
+        template<uint M>
+        size_t compress_frame(Config &frameConf) {
+            size_t frameCap = header_size() + SZ_compress_bound_impl<T, M>(frameConf);
+            if (frame.size() < frameCap) {
+                frame.resize(frameCap);
+            }
+            auto dst = (uchar *) frame.data() + header_size();
+            return SZ_compress_impl<T, M>(frameConf, window.data(), dst, frame.size() - header_size(), ctx);
+        }
+
+        Config conf;
+        size_t windowRows;
+        Sink sink;
+        size_t rowSize = 1;
+        size_t rowsBuffered = 0;
+        size_t rowsPushed = 0;
+        size_t frameCount = 0;
+        size_t compressedSize = 0;
+        bool finished = false;
+        std::vector<T> window;
+        std::vector<char> frame;
+        Context ctx;
+    };
+
+    /**
+     * StreamDecompressor restores a field compressed by StreamCompressor.
+     * The compressed bytes can be pushed in chunks of any size, every complete frame is decompressed and
+     * its rows are handed to the sink, so peak memory is bounded by one frame and its window, as for compression.
+     *
+     * example:
+     * SZ3::StreamDecompressor<float, 3> stream([&](const float *rows, size_t nRows) {
+     *     consume(rows, nRows);
+     * });
+     * while (size_t len = read(buf, sizeof(buf))) {
+     *     stream.push(buf, len);
+     * }
+     * stream.finish();
+     *
+     * @tparam T source data type
+     * @tparam N number of dimensions of the whole field
+     */
+    template<class T, uint N>
+    class StreamDecompressor {
+    public:
+        typedef std::function<void(const T *rows, size_t nRows)> Sink;
+
+        /**
+         * @param sink callback receiving the rows of each frame along dims[0], the memory is reused after the callback returns
+         */
+        explicit StreamDecompressor(Sink sink) : sink(std::move(sink)) {}
+
+        /**
+         * append compressed bytes, frames are decompressed as soon as they are complete
+         * @param data compressed bytes, a continuation of the previous push
+         * @param len number of bytes in data
+         */
+        void push(const char *data, size_t len) {
+            if (finished) {
+                throw std::invalid_argument("StreamDecompressor already finished");
+            }
+            pending.insert(pending.end(), data, data + len);
+            size_t pos = 0;
+            while (pending.size() - pos >= sizeof(size_t)) {
+                size_t streamSize;
+                std::memcpy(&streamSize, pending.data() + pos, sizeof(size_t));
+                if (streamSize < Config::size_est()) {
+                    throw std::invalid_argument("StreamDecompressor frame too small for its Config");
+                }
+                if (pending.size() - pos - sizeof(size_t) < streamSize) {
+                    break;
+                }
+                decompress_frame((const uchar *) pending.data() + pos + sizeof(size_t), streamSize);
+                pos += sizeof(size_t) + streamSize;
+            }
+            pending.erase(pending.begin(), pending.begin() + pos);
+        }
+
+        /**
+         * check that the stream ended on a frame boundary, no more bytes can be pushed afterwards
+         */
+        void finish() {
+            finished = true;
+            if (!pending.empty()) {
+                throw std::invalid_argument("StreamDecompressor stream truncated inside a frame");
+            }
+        }
+
+        size_t get_frame_count() const { return frameCount; }
+
+        size_t get_rows() const { return rows; }
+
+    private:
+        void decompress_frame(const uchar *stream, size_t streamSize) {
+            Config frameConf;
+            auto confPos = stream;
+            frameConf.load(confPos);
+            if (frameConf.N != N) {
+                throw std::invalid_argument("StreamDecompressor dimension mismatch with the frame");
+            }
+            if (window.size() < frameConf.num) {
+                window.resize(frameConf.num);
+            }
+            SZ_decompress_impl<T, N>(frameConf, stream + Config::size_est(), streamSize - Config::size_est(),
+                                     window.data(), ctx);
+            sink(window.data(), frameConf.dims[0]);
+            rows += frameConf.dims[0];
+            frameCount++;
+        }
+
+        Sink sink;
+        size_t frameCount = 0;
+        size_t rows = 0;
+        bool finished = false;
+        std::vector<char> pending;
+        std::vector<T> window;
+        Context ctx;
+    };
+}
+#endif
@@ -0,0 +1,320 @@
+#ifndef SZ3_IMPL_SZTILED_HPP
+#define SZ3_IMPL_SZTILED_HPP
+
+#include "SZ3/api/impl/SZDispatcher.hpp"
+#include "SZ3/utils/Config.hpp"
+#include "SZ3/utils/Context.hpp"
+#include "SZ3/utils/Layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _OPENMP
+
+#include <omp.h>
+
+#endif
+
+namespace SZ3 {
+
+    /**
+     * Tiled format (conf.tileSize > 0): the data is cut into tiles of tileSize along each dimension and every tile
+     * is compressed on its own, so a region can be decompressed by decoding only the tiles it overlaps.
+     * The last tile along a dimension also takes the remainder, so no tile is thinner than min(tileSize, dimension).
+     *
+     * Layout: the compressed size of every tile (row-major tile order),
+     * then for every tile its Config (padded to Config::size_est()) followed by its compressed data.
+     */
+    class TileGrid {
+    public:
+        explicit TileGrid(const Config &conf) : N(conf.N), bounds(conf.N), counts(conf.N) {
+            if (conf.tileSize < 2) {
+                throw std::invalid_argument("tileSize should be at least 2");
+            }
+            num = 1;
+            for (size_t d = 0; d < N; d++) {
+                counts[d] = std::max<size_t>(1, conf.dims[d] / conf.tileSize);
+                for (size_t i = 0; i < counts[d]; i++) {
+                    bounds[d].push_back(i * conf.tileSize);
+                }
+                bounds[d].push_back(conf.dims[d]);
+                num *= counts[d];
+            }
+        }
+
+        // counts[d] tiles of balanced size along every dimension d
+        TileGrid(const std::vector<size_t> &dims, const std::vector<size_t> &counts) :
+                N(dims.size()), bounds(dims.size()), counts(counts) {
+            num = 1;
+            for (size_t d = 0; d < N; d++) {
+                for (size_t i = 0; i <= counts[d]; i++) {
+                    bounds[d].push_back(i * dims[d] / counts[d]);
+                }
+                num *= counts[d];
+            }
+        }
+
+        // start and size of a tile
+        void tile(size_t id, std::vector<size_t> &start, std::vector<size_t> &size) const {
+            start.resize(N);
+            size.resize(N);
+            for (size_t d = N; d-- > 0;) {
+                size_t i = id % counts[d];
+                id /= counts[d];
+                start[d] = bounds[d][i];
+                size[d] = bounds[d][i + 1] - bounds[d][i];
+            }
+        }
+
+        // tiles overlapping the box [lo, hi)
+        std::vector<size_t> overlapping(const std::vector<size_t> &lo, const std::vector<size_t> &hi) const {
+            std::vector<size_t> ids = {0};
+            for (size_t d = 0; d < N; d++) {
+                std::vector<size_t> next;
+                for (auto id: ids) {
+                    for (size_t i = 0; i < counts[d]; i++) {
+                        if (bounds[d][i] < hi[d] && bounds[d][i + 1] > lo[d]) {
+                            next.push_back(id * counts[d] + i);
+                        }
+                    }
+                }
+                ids.swap(next);
+            }
+            return ids;
+        }
+
+        size_t num;
+
+    private:
+        size_t N;
+        std::vector<std::vector<size_t>> bounds;
+        std::vector<size_t> counts;
+    };
+
+    // configuration of one tile
+    inline Config tile_config(const Config &conf, const std::vector<size_t> &size) {
+        Config conf_t = conf;
+        conf_t.tileSize = 0;
+        conf_t.openmp = false;
+        conf_t.setDims(size.begin(), size.end());
+        return conf_t;
+    }
+
+    /**
+     * @param strides layout of data (see Layout.hpp), contiguous if empty
+     */
+    template<class T, uint N>
+    size_t SZ_compress_tiled(Config &conf, const T *data, uchar *cmpData, size_t cmpCap, Context &ctx,
+                             const std::vector<size_t> &strides = {}) {
+        assert(N == conf.N);
+        // error bounds relative to the value range use the range of the whole data, not of each tile
+        calAbsErrorBound(conf, data, strides);
+        auto dataStrides = strides.empty() ? contiguous_strides(conf.dims) : strides;
+
+        TileGrid grid(conf);
+        std::vector<size_t> cmpSize_t(grid.num);
+        if (cmpCap < grid.num * sizeof(size_t)) {
+            throw CapacityError("cmpCap too small for the tiles");
+        }
+        uchar *tilePos = cmpData + grid.num * sizeof(size_t);
+
+        // compress a tile to dst, its Config goes in front of the compressed data
+        auto compress_tile = [&](size_t id, std::vector<T> &tileData, uchar *dst, size_t dstCap, Context &ctx_t) {
+            if (dstCap < Config::size_est()) {
+                throw CapacityError("cmpCap too small for the tiles");
+            }
+            std::vector<size_t> start, size;
+            grid.tile(id, start, size);
+            Config conf_t = tile_config(conf, size);
+            tileData.resize(conf_t.num);
+            copy_box(data, dataStrides, start, tileData.data(), contiguous_strides(size), std::vector<size_t>(N, 0), size);
+            size_t cmpSize = SZ_compress_dispatcher<T, N>(conf_t, tileData.data(), dst + Config::size_est(),
+                                                          dstCap - Config::size_est(), ctx_t);
+            conf_t.save(dst);
+            return Config::size_est() + cmpSize;
+        };
+
+#ifndef _OPENMP
+        conf.openmp = false;
+#endif
+        if (conf.openmp) {
+            std::vector<std::vector<uchar>> cmpData_t(grid.num);
+            std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+            {
+                Context ctx_t;
+                std::vector<T> tileData;
+                std::vector<size_t> start, size;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+                for (size_t id = 0; id < grid.num; id++) {
+                    try {
+                        grid.tile(id, start, size);
+                        cmpData_t[id].resize(Config::size_est() + SZ_compress_bound_dispatcher<T, N>(tile_config(conf, size)));
+                        cmpSize_t[id] = compress_tile(id, tileData, cmpData_t[id].data(), cmpData_t[id].size(), ctx_t);
+                    } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            for (size_t id = 0; id < grid.num; id++) {
+                if (cmpSize_t[id] > cmpCap - (tilePos - cmpData)) {
+                    throw CapacityError("cmpCap too small for the tiles");
+                }
+                memcpy(tilePos, cmpData_t[id].data(), cmpSize_t[id]);
+                tilePos += cmpSize_t[id];
+            }
+        } else {
+            std::vector<T> tileData;
+            std::vector<size_t> start, size;
+            for (size_t id = 0; id < grid.num; id++) {
+                // a tile gets no more room than its bound, larger lossy data is stored as is and leaves room for the next tiles
+                grid.tile(id, start, size);
+                size_t tileCap = Config::size_est() + SZ_compress_bound_dispatcher<T, N>(tile_config(conf, size));
+                cmpSize_t[id] = compress_tile(id, tileData, tilePos, std::min(tileCap, cmpCap - (tilePos - cmpData)), ctx);
+                tilePos += cmpSize_t[id];
+            }
+        }
+
+        uchar *sizePos = cmpData;
+        write(cmpSize_t.data(), grid.num, sizePos);
+        return tilePos - cmpData;
+    }
+
+    // worst-case size of SZ_compress_tiled
+    template<class T, uint N>
+    size_t SZ_compress_tiled_bound(const Config &conf) {
+        TileGrid grid(conf);
+        size_t bound = grid.num * sizeof(size_t);
+        // there are at most 2^N different tile shapes
+        std::map<std::vector<size_t>, size_t> shapeBound;
+        std::vector<size_t> start, size;
+        for (size_t id = 0; id < grid.num; id++) {
+            grid.tile(id, start, size);
+            auto it = shapeBound.find(size);
+            if (it == shapeBound.end()) {
+                it = shapeBound.emplace(size, Config::size_est() + SZ_compress_bound_dispatcher<T, N>(tile_config(conf, size))).first;
+            }
+            bound += it->second;
+        }
+        return bound;
+    }
+
+    /**
+     * decompress the box [lo, hi) of tiled data, decoding only the tiles it overlaps
+     * @param decData output of shape hi - lo
+     * @param strides layout of decData (see Layout.hpp), contiguous if empty
+     */
+    template<class T, uint N>
+    void SZ_decompress_tiled_region(const Config &conf, const uchar *cmpData, size_t cmpSize,
+                                    const std::vector<size_t> &lo, const std::vector<size_t> &hi, T *decData, Context &ctx,
+                                    const std::vector<size_t> &strides = {}) {
+        TileGrid grid(conf);
+        std::vector<size_t> cmpSize_t(grid.num), cmpStart_t(grid.num);
+        if (cmpSize < grid.num * sizeof(size_t)) {
+            throw std::invalid_argument("cmpSize too small for the tile sizes");
+        }
+        auto cmpDataPos = cmpData;
+        read(cmpSize_t.data(), grid.num, cmpDataPos);
+        cmpSize -= grid.num * sizeof(size_t);
+        for (size_t id = 0, start = 0; id < grid.num; id++) {
+            if (cmpSize_t[id] < Config::size_est() || cmpSize_t[id] > cmpSize - start) {
+                throw std::invalid_argument("tile size out of the range of the compressed data");
+            }
+            cmpStart_t[id] = start;
+            start += cmpSize_t[id];
+        }
+
+        std::vector<size_t> regionDims(N);
+        for (size_t d = 0; d < N; d++) {
+            regionDims[d] = hi[d] - lo[d];
+        }
+        auto decStrides = strides.empty() ? contiguous_strides(regionDims) : strides;
+        auto ids = grid.overlapping(lo, hi);
+
+        auto decompress_tile = [&](size_t id, std::vector<T> &tileData, Context &ctx_t) {
+            std::vector<size_t> start, size;
+            grid.tile(id, start, size);
+            auto tilePos = cmpDataPos + cmpStart_t[id];
+            Config conf_t;
+            conf_t.load(tilePos);
+            if (conf_t.N != N || conf_t.dims != size || conf_t.num != std::accumulate(size.begin(), size.end(), (size_t) 1, std::multiplies<size_t>())) {
+                throw std::invalid_argument("tile shape does not match the tile grid");
+            }
+            tileData.resize(conf_t.num);
+            SZ_decompress_dispatcher<T, N>(conf_t, cmpDataPos + cmpStart_t[id] + Config::size_est(),
+                                           cmpSize_t[id] - Config::size_est(), tileData.data(), ctx_t);
+
+            std::vector<size_t> srcStart(N), dstStart(N), boxSize(N);
+            for (size_t d = 0; d < N; d++) {
+                size_t boxLo = std::max(lo[d], start[d]), boxHi = std::min(hi[d], start[d] + size[d]);
+                srcStart[d] = boxLo - start[d];
+                dstStart[d] = boxLo - lo[d];
+                boxSize[d] = boxHi - boxLo;
+            }
+            copy_box(tileData.data(), contiguous_strides(size), srcStart, decData, decStrides, dstStart, boxSize);
+        };
+
+        bool openmp = conf.openmp;
+#ifndef _OPENMP
+        openmp = false;
+#endif
+        if (openmp) {
+            std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+            {
+                Context ctx_t;
+                std::vector<T> tileData;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+                for (size_t i = 0; i < ids.size(); i++) {
+                    try {
+                        decompress_tile(ids[i], tileData, ctx_t);
+                    } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } else {
+            std::vector<T> tileData;
+            for (auto id: ids) {
+                decompress_tile(id, tileData, ctx);
+            }
+        }
+    }
+
+    template<class T, uint N>
+    void SZ_decompress_tiled(const Config &conf, const uchar *cmpData, size_t cmpSize, T *decData, Context &ctx,
+                             const std::vector<size_t> &strides = {}) {
+        SZ_decompress_tiled_region<T, N>(conf, cmpData, cmpSize, std::vector<size_t>(N, 0), conf.dims, decData, ctx, strides);
+    }
+}
+
+#endif
@@ -2,8 +2,96 @@
 #define SZ3_SZ_HPP
 
 #include "SZ3/api/impl/SZImpl.hpp"
+#include "SZ3/api/impl/SZImplStream.hpp"
+#include "SZ3/utils/ThreadPool.hpp"
 #include "SZ3/version.hpp"
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
+#include <vector>
+
+/**
+ * API for the worst-case compressed size
+ * @tparam T source data type
+ * @param conf compression configuration, the same one to be passed to SZ_compress
+ * @return a cmpCap that SZ_compress(conf, data, cmpData, cmpCap) always fits in, for any data of this shape:
+ * the size of the data stored as is, plus the header (and the headers of the tiles if conf.tileSize is set).
+ * Data whose lossy compression would be larger is stored as is, and OpenMP blocks that would not fit are compressed
+ * in one piece, so the bound does not depend on the number of threads.
+ * Smaller buffers (e.g., conf.num * sizeof(T)) are accepted as well, SZ_compress throws SZ3::CapacityError (a std::length_error) if the data does not fit.
+
+ example:
+ size_t cmpCap = SZ_compress_bound<float>(conf);
+ auto cmpData = new char[cmpCap];
+ size_t cmpSize = SZ_compress(conf, data, cmpData, cmpCap);
+ */
+template<class T>
+size_t SZ_compress_bound(const SZ3::Config &conf_) {
+    using namespace SZ3;
+    Config conf(conf_);
+    
+    size_t dstBound = 0;
+    if (conf.N == 1) {
+        dstBound = SZ_compress_bound_impl<T, 1>(conf);
+    } else if (conf.N == 2) {
+        dstBound = SZ_compress_bound_impl<T, 2>(conf);
+    } else if (conf.N == 3) {
+        dstBound = SZ_compress_bound_impl<T, 3>(conf);
+    } else if (conf.N == 4) {
+        dstBound = SZ_compress_bound_impl<T, 4>(conf);
+    } else {
+        printf("Data dimension higher than 4 is not supported.\n");
+        exit(0);
+    }
+    return conf.size_est() + dstBound;
+}
+
+/**
+ * API for compressing data that is not contiguous in memory, e.g., the interior of a field with ghost cells,
+ * or one component of an array of structs. The compressed data is the same as for a contiguous copy of data.
+ * @param strides stride (in elements) of every dimension of data, see SZ3/utils/Layout.hpp; contiguous if empty
+
+ example, the 100 x 200 interior of a 102 x 202 field u:
+ SZ3::Config conf(100, 200);
+ size_t cmpSize = SZ_compress(conf, u + 202 + 1, {202, 1}, cmpData, cmpCap);
+ */
+template<class T>
+size_t SZ_compress(const SZ3::Config &conf_, const T *data, const std::vector<size_t> &strides,
+                   char *cmpData, size_t cmpCap, SZ3::Context &ctx) {
+    using namespace SZ3;
+    Config conf(conf_);
+    
+    if (cmpCap < conf.size_est()) {
+        throw CapacityError("cmpCap too small, SZ_compress_bound(conf) bytes are always enough");
+    }
+    if (!strides.empty() && strides.size() != (size_t) conf.N) {
+        throw std::invalid_argument("strides should have one entry per dimension");
+    }
+    
+    auto dst = (uchar*)cmpData + conf.size_est();
+    auto dstCap = cmpCap - conf.size_est();
+    
+    size_t dstLen = 0;
+    if (conf.N == 1) {
+        dstLen = SZ_compress_impl<T, 1>(conf, data, dst, dstCap, ctx, strides);
+    } else if (conf.N == 2) {
+        dstLen = SZ_compress_impl<T, 2>(conf, data, dst, dstCap, ctx, strides);
+    } else if (conf.N == 3) {
+        dstLen = SZ_compress_impl<T, 3>(conf, data, dst, dstCap, ctx, strides);
+    } else if (conf.N == 4) {
+        dstLen = SZ_compress_impl<T, 4>(conf, data, dst, dstCap, ctx, strides);
+    } else {
+        printf("Data dimension higher than 4 is not supported.\n");
+        exit(0);
+    }
+    
+    
+    auto confPos = (uchar *) cmpData;
+    conf.save(confPos);
+    return conf.size_est() + dstLen;
+}
 
 /**
  * API for compression
@@ -11,6 +99,7 @@
  * @param config compression configuration. Please update the config with 1). data dimension and shape and 2). desired settings.
  * @param data source data
  * @param cmpSize compressed data size in bytes
+ * @param ctx (overloads taking it) reusable resources kept across calls, see SZ3::Context
  * @return compressed data, remember to 'delete []' when the data is no longer needed.
 
 The compression algorithms are:
@@ -50,50 +139,156 @@ conf.absErrorBound = 1E-3; // absolute error bound 1e-3
 char *compressedData = SZ_compress(conf, data, outSize);
  */
 template<class T>
-size_t SZ_compress(const SZ3::Config &conf_, const T *data, char *cmpData, size_t cmpCap) {
+size_t SZ_compress(const SZ3::Config &conf, const T *data, char *cmpData, size_t cmpCap, SZ3::Context &ctx) {
+    return SZ_compress(conf, data, {}, cmpData, cmpCap, ctx);
+}
+
+/**
+ * API for compression, same as above but with a fresh context for this call only
+ */
+template<class T>
+size_t SZ_compress(const SZ3::Config &conf, const T *data, char *cmpData, size_t cmpCap) {
+    SZ3::Context ctx;
+    return SZ_compress(conf, data, cmpData, cmpCap, ctx);
+}
+
+/**
+ * API for compressing strided data, same as above but with a fresh context for this call only
+ */
+template<class T>
+size_t SZ_compress(const SZ3::Config &conf, const T *data, const std::vector<size_t> &strides, char *cmpData, size_t cmpCap) {
+    SZ3::Context ctx;
+    return SZ_compress(conf, data, strides, cmpData, cmpCap, ctx);
+}
+
+template<class T>
+char *SZ_compress(const SZ3::Config &conf, const T *data, size_t &cmpSize) {
     using namespace SZ3;
-    Config conf(conf_);
     
-    if (cmpCap < conf.num * sizeof(T)) {
-        throw std::invalid_argument(
-            "cmpCap too small, remember to initialize the cmpCap with at least the same size of the original data");
-    }
+    size_t bufferLen = SZ_compress_bound<T>(conf);
+    auto buffer = new char[bufferLen];
+    cmpSize = SZ_compress(conf, data, buffer, bufferLen);
     
-    auto dst = (uchar*)cmpData + conf.size_est();
-    auto dstCap = cmpCap - conf.size_est();
+    return buffer;
+}
+
+
+/**
+ * API for asynchronous compression
+ * The compression runs on a worker thread of SZ3::ThreadPool::shared(), the pool and the SZ3::Context of each worker
+ * are kept across calls. Calls are started in submission order.
+ * consumed is called (on the worker thread) once data is no longer read, the caller may then reuse or free data,
+ * e.g., to compute the next timestep while the compressed data of this one is being written by sink.
+ * @tparam T source data type
+ * @param conf compression configuration, copied
+ * @param data source data, to be kept until consumed is called
+ * @param sink called on the worker thread with the compressed data, which is only valid during the call
+ * @param consumed optional, called once data is no longer needed, also when the compression fails
+ * @return future of the compressed size, ready after sink returns. get() rethrows the exceptions of the compression and of sink.
+
+ example:
+ std::vector<std::future<size_t>> pending;
+ for (int step = 0; step < steps; step++) {
+     simulate(field);
+     std::promise<void> consumed;
+     auto fieldFree = consumed.get_future();
+     pending.push_back(SZ_compress_async(conf, field,
+                       [&, step](const char *cmpData, size_t cmpSize) { writeFile(step, cmpData, cmpSize); },
+                       [&consumed] { consumed.set_value(); }));
+     fieldFree.wait(); // field can be overwritten by the next step
+ }
+ for (auto &f: pending) f.get();
+ */
+template<class T>
+std::future<size_t> SZ_compress_async(const SZ3::Config &conf, const T *data,
+                                      std::function<void(const char *, size_t)> sink,
+                                      std::function<void()> consumed = nullptr) {
+    return SZ3::ThreadPool::shared().submit([conf, data, sink, consumed]() {
+        static thread_local SZ3::Context ctx;
+        size_t cmpCap = 0, cmpSize = 0;
+        std::unique_ptr<char[]> cmpData;
+        try {
+            cmpCap = SZ_compress_bound<T>(conf);
+            cmpData.reset(new char[cmpCap]);
+            cmpSize = SZ_compress(conf, data, cmpData.get(), cmpCap, ctx);
+        } catch (...) {
+            if (consumed) {
+                consumed();
+            }
+            throw;
+        }
+        if (consumed) {
+            consumed();
+        }
+        if (sink) {
+            sink(cmpData.get(), cmpSize);
+        }
+        return cmpSize;
+    });
+}
+
+/**
+ * API for asynchronous compression into a buffer of the caller
+ * Same as above, the compressed data is in cmpData when the future is ready.
+ * @param cmpData pre-allocated memory of cmpCap >= SZ_compress_bound<T>(conf) bytes, to be kept until the future is ready
+ */
+template<class T>
+std::future<size_t> SZ_compress_async(const SZ3::Config &conf, const T *data, char *cmpData, size_t cmpCap,
+                                      std::function<void()> consumed = nullptr) {
+    return SZ3::ThreadPool::shared().submit([conf, data, cmpData, cmpCap, consumed]() {
+        static thread_local SZ3::Context ctx;
+        size_t cmpSize = 0;
+        try {
+            cmpSize = SZ_compress(conf, data, cmpData, cmpCap, ctx);
+        } catch (...) {
+            if (consumed) {
+                consumed();
+            }
+            throw;
+        }
+        if (consumed) {
+            consumed();
+        }
+        return cmpSize;
+    });
+}
+
+
+/**
+ * API for decompressing into memory that is not contiguous, e.g., the interior of a field with ghost cells,
+ * or one component of an array of structs. Elements of decData outside the layout are left untouched.
+ * @param decData pre-allocated memory space, the first decompressed element goes to decData[0]
+ * @param strides stride (in elements) of every dimension of decData, see SZ3/utils/Layout.hpp; contiguous if empty
+ */
+template<class T>
+void SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize, T *decData, const std::vector<size_t> &strides,
+                   SZ3::Context &ctx) {
+    using namespace SZ3;
+    auto confPos = (const uchar *) cmpData;
+    if (cmpSize < conf.size_est()) {
+        throw std::invalid_argument("cmpSize too small for the Config of the compressed data");
+    }
+    auto cmpDataPos = confPos + conf.size_est();
+    cmpSize -= conf.size_est();
+    conf.load(confPos);
     
-    size_t dstLen = 0;
+    if (!strides.empty() && strides.size() != (size_t) conf.N) {
+        throw std::invalid_argument("strides should have one entry per dimension");
+    }
     if (conf.N == 1) {
-        dstLen = SZ_compress_impl<T, 1>(conf, data, dst, dstCap);
+        SZ_decompress_impl<T, 1>(conf, cmpDataPos, cmpSize, decData, ctx, strides);
     } else if (conf.N == 2) {
-        dstLen = SZ_compress_impl<T, 2>(conf, data, dst, dstCap);
+        SZ_decompress_impl<T, 2>(conf, cmpDataPos, cmpSize, decData, ctx, strides);
     } else if (conf.N == 3) {
-        dstLen = SZ_compress_impl<T, 3>(conf, data, dst, dstCap);
+        SZ_decompress_impl<T, 3>(conf, cmpDataPos, cmpSize, decData, ctx, strides);
     } else if (conf.N == 4) {
-        dstLen = SZ_compress_impl<T, 4>(conf, data, dst, dstCap);
+        SZ_decompress_impl<T, 4>(conf, cmpDataPos, cmpSize, decData, ctx, strides);
     } else {
         printf("Data dimension higher than 4 is not supported.\n");
         exit(0);
     }
-    
-    
-    auto confPos = (uchar *) cmpData;
-    conf.save(confPos);
-    return conf.size_est() + dstLen;
-}
-
-template<class T>
-char *SZ_compress(const SZ3::Config &conf, const T *data, size_t &cmpSize) {
-    using namespace SZ3;
-    
-    size_t bufferLen = conf.num * sizeof(T) * 1.2;
-    auto buffer = new char[bufferLen];
-    cmpSize = SZ_compress(conf, data, buffer, bufferLen);
-    
-    return buffer;
 }
 
-
 /**
  * API for decompression
  * Similar with SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize)
@@ -111,23 +306,142 @@ char *SZ_compress(const SZ3::Config &conf, const T *data, size_t &cmpSize) {
 
  */
 template<class T>
+void SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize, T *&decData, SZ3::Context &ctx) {
+    if (decData == nullptr) {
+        auto confPos = (const SZ3::uchar *) cmpData;
+        conf.load(confPos);
+        decData = new T[conf.num];
+    }
+    SZ_decompress(conf, cmpData, cmpSize, (T *) decData, {}, ctx);
+}
+
+/**
+ * API for decompression, same as above but with a fresh context for this call only
+ */
+template<class T>
 void SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize, T *&decData) {
+    SZ3::Context ctx;
+    SZ_decompress(conf, cmpData, cmpSize, decData, ctx);
+}
+
+/**
+ * API for decompressing into strided memory, same as above but with a fresh context for this call only
+ */
+template<class T>
+void SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize, T *decData, const std::vector<size_t> &strides) {
+    SZ3::Context ctx;
+    SZ_decompress(conf, cmpData, cmpSize, decData, strides, ctx);
+}
+
+/**
+ * API for decompressing a region
+ * Only the tiles overlapping the region are decoded if the data was compressed with conf.tileSize > 0,
+ * otherwise the whole data is decompressed and the region is copied out.
+ * @tparam T decompressed data type
+ * @param conf configuration placeholder. It will be overwritten by the compression configuration
+ * @param cmpData compressed data
+ * @param cmpSize compressed data size in bytes
+ * @param lo first index of the region in each dimension of conf.dims (dimensions of size 1 are not counted)
+ * @param hi end index (exclusive) of the region in each dimension
+ * @param decData pre-allocated memory space for the region (of shape hi - lo), allocated with 'new []' if nullptr
+
+ example:
+ conf.tileSize = 64;
+ char *cmpData = SZ_compress(conf, data, cmpSize);
+ ...
+ float *slice = nullptr;
+ SZ_decompress_region(conf, cmpData, cmpSize, {10, 0, 0}, {11, 200, 300}, slice);
+ */
+template<class T>
+void SZ_decompress_region(SZ3::Config &conf, char *cmpData, size_t cmpSize,
+                          const std::vector<size_t> &lo, const std::vector<size_t> &hi, T *&decData) {
     using namespace SZ3;
     auto confPos = (const uchar *) cmpData;
+    if (cmpSize < conf.size_est()) {
+        throw std::invalid_argument("cmpSize too small for the Config of the compressed data");
+    }
     auto cmpDataPos = confPos + conf.size_est();
+    cmpSize -= conf.size_est();
     conf.load(confPos);
     
+    if (lo.size() != (size_t) conf.N || hi.size() != (size_t) conf.N) {
+        throw std::invalid_argument("region should have one index per dimension of the data");
+    }
+    size_t regionNum = 1;
+    for (int d = 0; d < conf.N; d++) {
+        if (lo[d] >= hi[d] || hi[d] > conf.dims[d]) {
+            throw std::invalid_argument("region is empty or out of the data");
+        }
+        regionNum *= hi[d] - lo[d];
+    }
+    
     if (decData == nullptr) {
-        decData = new T[conf.num];
+        decData = new T[regionNum];
     }
+    Context ctx;
     if (conf.N == 1) {
-        SZ_decompress_impl<T, 1>(conf, cmpDataPos, cmpSize, decData);
+        SZ_decompress_region_impl<T, 1>(conf, cmpDataPos, cmpSize, lo, hi, decData, ctx);
     } else if (conf.N == 2) {
-        SZ_decompress_impl<T, 2>(conf, cmpDataPos, cmpSize, decData);
+        SZ_decompress_region_impl<T, 2>(conf, cmpDataPos, cmpSize, lo, hi, decData, ctx);
     } else if (conf.N == 3) {
-        SZ_decompress_impl<T, 3>(conf, cmpDataPos, cmpSize, decData);
+        SZ_decompress_region_impl<T, 3>(conf, cmpDataPos, cmpSize, lo, hi, decData, ctx);
     } else if (conf.N == 4) {
-        SZ_decompress_impl<T, 4>(conf, cmpDataPos, cmpSize, decData);
+        SZ_decompress_region_impl<T, 4>(conf, cmpDataPos, cmpSize, lo, hi, decData, ctx);
+    } else {
+        printf("Data dimension higher than 4 is not supported.\n");
+        exit(0);
+    }
+}
+
+/**
+ * API for decompressing at a lower resolution
+ * With conf.progressive, the interpolation levels are stored apart and only the coarse ones are read and decoded,
+ * e.g., level 3 reads and decodes about 1/8^N of the points of N-D data. Other data is decompressed in full and subsampled.
+ * The decoded points keep the error bound, the points predicted by upsample do not.
+ * @tparam T decompressed data type
+ * @param conf configuration placeholder. It will be overwritten by the compression configuration
+ * @param cmpData compressed data
+ * @param cmpSize compressed data size in bytes
+ * @param level the points every 2^level along each dimension are decoded (0 is the full resolution)
+ * @param decData pre-allocated memory space, allocated with 'new []' if nullptr.
+ *        Of shape SZ3::level_dims(conf.dims, level), or of shape conf.dims with upsample
+ * @param upsample return the full grid, with the points of the finer levels predicted from the decoded ones
+
+ example:
+ conf.progressive = true;
+ char *cmpData = SZ_compress(conf, data, cmpSize);
+ ...
+ float *preview = nullptr;
+ SZ_decompress_level(conf, cmpData, cmpSize, 3, preview); // 1/8 resolution along each dimension
+ */
+template<class T>
+void SZ_decompress_level(SZ3::Config &conf, char *cmpData, size_t cmpSize, uint level, T *&decData,
+                         bool upsample = false) {
+    using namespace SZ3;
+    auto confPos = (const uchar *) cmpData;
+    if (cmpSize < conf.size_est()) {
+        throw std::invalid_argument("cmpSize too small for the Config of the compressed data");
+    }
+    auto cmpDataPos = confPos + conf.size_est();
+    cmpSize -= conf.size_est();
+    conf.load(confPos);
+    
+    if (decData == nullptr) {
+        size_t levelNum = 1;
+        for (auto dim: upsample ? conf.dims : level_dims(conf.dims, level)) {
+            levelNum *= dim;
+        }
+        decData = new T[levelNum];
+    }
+    Context ctx;
+    if (conf.N == 1) {
+        SZ_decompress_level_impl<T, 1>(conf, cmpDataPos, cmpSize, level, upsample, decData, ctx);
+    } else if (conf.N == 2) {
+        SZ_decompress_level_impl<T, 2>(conf, cmpDataPos, cmpSize, level, upsample, decData, ctx);
+    } else if (conf.N == 3) {
+        SZ_decompress_level_impl<T, 3>(conf, cmpDataPos, cmpSize, level, upsample, decData, ctx);
+    } else if (conf.N == 4) {
+        SZ_decompress_level_impl<T, 4>(conf, cmpDataPos, cmpSize, level, upsample, decData, ctx);
     } else {
         printf("Data dimension higher than 4 is not supported.\n");
         exit(0);
@@ -154,4 +468,231 @@ T *SZ_decompress(SZ3::Config &conf, char *cmpData, size_t cmpSize) {
     return decData;
 }
 
-#endif
\ No newline at end of file
+/**
+ * API for compressing many arrays of the same shape and error bound in one call
+ * The algorithm is tuned once on a representative array (ALGO_INTERP_LORENZO) instead of once per array,
+ * and the arrays are compressed in parallel when OpenMP is enabled.
+ * With shareCodebook, one Huffman tree learned from a few arrays is stored once in the output and
+ * used by every array it has codes for, which saves building and storing a tree per array.
+ * The error bound is still evaluated per array (e.g., REL uses the value range of each array).
+ * The Config is stored once for the batch, each array only keeps its absolute error bound.
+ * @tparam T source data type
+ * @param conf compression configuration shared by all arrays
+ * @param inputs source arrays, conf.num elements each
+ * @param cmpSize compressed data size in bytes
+ * @param shareCodebook share one Huffman tree across the arrays
+ * @return compressed data, remember to 'delete []' when the data is no longer needed.
+
+ example:
+ std::vector<const float *> inputs = {a, b, c};
+ char *cmpData = SZ_compress_batch(conf, inputs, cmpSize, true);
+ */
+template<class T>
+char *SZ_compress_batch(const SZ3::Config &conf, const std::vector<const T *> &inputs, size_t &cmpSize,
+                        bool shareCodebook = false) {
+    using namespace SZ3;
+    size_t count = inputs.size();
+    Config confBatch(conf);
+    confBatch.openmp = false;
+    Context ctx;
+    
+    if (count > 0) {
+        // tune on the array in the middle, keep the error bound mode so every array gets its own absolute bound
+        Config confTuned(confBatch);
+        auto representative = inputs[count / 2];
+        if (conf.N == 1) {
+            SZ_tune_impl<T, 1>(confTuned, representative, ctx);
+        } else if (conf.N == 2) {
+            SZ_tune_impl<T, 2>(confTuned, representative, ctx);
+        } else if (conf.N == 3) {
+            SZ_tune_impl<T, 3>(confTuned, representative, ctx);
+        } else if (conf.N == 4) {
+            SZ_tune_impl<T, 4>(confTuned, representative, ctx);
+        } else {
+            printf("Data dimension higher than 4 is not supported.\n");
+            exit(0);
+        }
+        confTuned.errorBoundMode = conf.errorBoundMode;
+        confTuned.absErrorBound = conf.absErrorBound;
+        confBatch = confTuned;
+    }
+    
+    // compress one array, without its Config, into dst; conf_t gets the absolute error bound of the array
+    auto compress_array = [&](Config &conf_t, const T *data, uchar *dst, size_t dstCap, Context &ctx_t) -> size_t {
+        if (conf.N == 1) {
+            return SZ_compress_impl<T, 1>(conf_t, data, dst, dstCap, ctx_t);
+        } else if (conf.N == 2) {
+            return SZ_compress_impl<T, 2>(conf_t, data, dst, dstCap, ctx_t);
+        } else if (conf.N == 3) {
+            return SZ_compress_impl<T, 3>(conf_t, data, dst, dstCap, ctx_t);
+        } else if (conf.N == 4) {
+            return SZ_compress_impl<T, 4>(conf_t, data, dst, dstCap, ctx_t);
+        }
+        printf("Data dimension higher than 4 is not supported.\n");
+        exit(0);
+    };
+    
+    // room of one array, the data of an array that does not fit is stored as is
+    size_t cmpCap = SZ_compress_bound<T>(confBatch) - confBatch.size_est();
+    if (shareCodebook && count > 0) {
+        // learn the tree from up to 4 arrays spread over the batch
+        std::vector<uchar> scratch(cmpCap);
+        size_t samples = std::min<size_t>(count, 4);
+        ctx.encoder.learn_shared_tree();
+        for (size_t i = 0; i < samples; i++) {
+            Config conf_t(confBatch);
+            compress_array(conf_t, inputs[i * count / samples], scratch.data(), cmpCap, ctx);
+        }
+        ctx.encoder.build_shared_tree();
+    }
+    
+    /*
+     * Layout: the number of arrays, whether a shared tree follows, the shared tree, the Config of the batch,
+     * the absolute error bound and the compressed size of every array, then the compressed arrays.
+     * Every array is compressed straight into its slot of the output, then the arrays are moved down to follow each other.
+     */
+    uchar hasSharedTree = ctx.encoder.has_shared_tree();
+    size_t headerLen = sizeof(size_t) + sizeof(uchar) + (hasSharedTree ? ctx.encoder.shared_tree_size_est() : 0)
+                       + confBatch.size_est() + count * (sizeof(double) + sizeof(size_t));
+    auto buffer = new char[headerLen + count * cmpCap];
+    auto slots = (uchar *) buffer + headerLen;
+    std::vector<double> eb_t(count);
+    std::vector<size_t> cmpSize_t(count);
+    std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        Context ctx_t;
+        ctx_t.encoder.use_shared_tree_of(ctx.encoder);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (size_t i = 0; i < count; i++) {
+            try {
+                Config conf_t(confBatch);
+                cmpSize_t[i] = compress_array(conf_t, inputs[i], slots + i * cmpCap, cmpCap, ctx_t);
+                eb_t[i] = conf_t.absErrorBound;
+            } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (error) {
+        delete[] buffer;
+        std::rethrow_exception(error);
+    }
+    
+    auto bufferPos = (uchar *) buffer;
+    write(count, bufferPos);
+    write(hasSharedTree, bufferPos);
+    if (hasSharedTree) {
+        ctx.encoder.save_shared_tree(bufferPos);
+    }
+    auto confPos = bufferPos;
+    confBatch.save(confPos);
+    bufferPos += confBatch.size_est();
+    write(eb_t.data(), count, bufferPos);
+    write(cmpSize_t.data(), count, bufferPos);
+    // every array moves down, never past the start of its own slot, so it only overwrites free space
+    for (size_t i = 0; i < count; i++) {
+        memmove(bufferPos, slots + i * cmpCap, cmpSize_t[i]);
+        bufferPos += cmpSize_t[i];
+    }
+    cmpSize = bufferPos - (uchar *) buffer;
+    return buffer;
+}
+
+/**
+ * API for decompressing the output of SZ_compress_batch
+ * @tparam T decompressed data type
+ * @param conf configuration placeholder. It will be overwritten by the compression configuration of the batch
+ * @param cmpData compressed data
+ * @param cmpSize compressed data size in bytes
+ * @param decData one pointer per array, resized to the number of arrays.
+ *        nullptr entries are allocated with 'new []', remember to 'delete []' them when no longer needed.
+ */
+template<class T>
+void SZ_decompress_batch(SZ3::Config &conf, char *cmpData, size_t cmpSize, std::vector<T *> &decData) {
+    using namespace SZ3;
+    auto cmpDataPos = (const uchar *) cmpData;
+    size_t remaining_length = cmpSize;
+    size_t count = 0;
+    uchar hasSharedTree = 0;
+    read(count, cmpDataPos, remaining_length);
+    read(hasSharedTree, cmpDataPos, remaining_length);
+    Context ctx;
+    if (hasSharedTree) {
+        ctx.encoder.load_shared_tree(cmpDataPos, remaining_length);
+    }
+    if (remaining_length < conf.size_est() || (remaining_length - conf.size_est()) / (sizeof(double) + sizeof(size_t)) < count) {
+        throw std::invalid_argument("cmpSize too small for the header of the batch");
+    }
+    auto confPos = cmpDataPos;
+    conf.load(confPos);
+    cmpDataPos += conf.size_est();
+    remaining_length -= conf.size_est();
+    std::vector<double> eb_t(count);
+    std::vector<size_t> cmpSize_t(count), cmpStart_t(count);
+    read(eb_t.data(), count, cmpDataPos, remaining_length);
+    read(cmpSize_t.data(), count, cmpDataPos, remaining_length);
+    for (size_t i = 0, start = 0; i < count; i++) {
+        if (cmpSize_t[i] > remaining_length - start) {
+            throw std::invalid_argument("cmpSize too small for the arrays of the batch");
+        }
+        cmpStart_t[i] = start;
+        start += cmpSize_t[i];
+    }
+    
+    decData.resize(count, nullptr);
+    for (auto &dec: decData) {
+        if (dec == nullptr) {
+            dec = new T[conf.num];
+        }
+    }
+    std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        Context ctx_t;
+        ctx_t.encoder.use_shared_tree_of(ctx.encoder);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (size_t i = 0; i < count; i++) {
+            try {
+                Config conf_t(conf);
+                conf_t.errorBoundMode = EB_ABS;
+                conf_t.absErrorBound = eb_t[i];
+                auto pos = cmpDataPos + cmpStart_t[i];
+                if (conf.N == 1) {
+                    SZ_decompress_impl<T, 1>(conf_t, pos, cmpSize_t[i], decData[i], ctx_t);
+                } else if (conf.N == 2) {
+                    SZ_decompress_impl<T, 2>(conf_t, pos, cmpSize_t[i], decData[i], ctx_t);
+                } else if (conf.N == 3) {
+                    SZ_decompress_impl<T, 3>(conf_t, pos, cmpSize_t[i], decData[i], ctx_t);
+                } else if (conf.N == 4) {
+                    SZ_decompress_impl<T, 4>(conf_t, pos, cmpSize_t[i], decData[i], ctx_t);
+                }
+            } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+#endif
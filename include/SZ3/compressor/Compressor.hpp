@@ -37,6 +37,13 @@ namespace SZ3::concepts {
          */
         virtual size_t compress(const Config &conf, T *data, uchar *cmpData, size_t cmpCap) = 0;
 
+        /**
+         * worst-case size of compress(), known before compression
+         * @param conf compression configuration
+         * @return a cmpCap that compress() never exceeds, in bytes
+         */
+        virtual size_t size_bound(const Config &conf) = 0;
+
     };
 }
 
@@ -22,8 +22,12 @@ namespace SZ3 {
     public:
 
 
-        SZGenericCompressor(Decomposition decomposition, Encoder encoder, Lossless lossless) :
-                decomposition(decomposition), encoder(encoder), lossless(lossless) {
+        /**
+         * @param buffer optional scratch space kept by the caller (e.g., SZ3::Context) and reused across calls,
+         *        a buffer owned by this compressor is used if it is nullptr
+         */
+        SZGenericCompressor(Decomposition decomposition, Encoder encoder, Lossless lossless, std::vector<uchar> *buffer = nullptr) :
+                decomposition(decomposition), encoder(encoder), lossless(lossless), buffer(buffer) {
             static_assert(std::is_base_of<concepts::DecompositionInterface<T, N>, Decomposition>::value,
                           "must implement the frontend interface");
             static_assert(std::is_base_of<concepts::EncoderInterface<int>, Encoder>::value,
@@ -35,28 +39,32 @@ namespace SZ3 {
         size_t compress(const Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
 
             std::vector<int> quant_inds = decomposition.compress(conf, data);
+            return encode_and_save(conf, quant_inds, cmpData, cmpCap);
+        }
 
-            encoder.preprocess_encode(quant_inds, decomposition.get_radius() * 2);
-            size_t bufferSize = std::max<size_t>(1000, 1.2 * (decomposition.size_est() + encoder.size_est() + sizeof(T) * quant_inds.size()));
-
-            auto buffer = (uchar *) malloc(bufferSize);
-            uchar *buffer_pos = buffer;
-
-            decomposition.save(buffer_pos);
-
-            encoder.save(buffer_pos);
-            encoder.encode(quant_inds, buffer_pos);
-            encoder.postprocess_encode();
+        /**
+         * compress data without modifying it
+         * only available when the decomposition provides compress(conf, const T *data),
+         * which keeps the reconstructed values in its own bounded scratch space
+         */
+        size_t compress(const Config &conf, const T *data, uchar *cmpData, size_t cmpCap) {
 
-            auto cmpSize = lossless.compress(buffer, buffer_pos - buffer, cmpData, cmpCap);
-            free(buffer);
+            std::vector<int> quant_inds = decomposition.compress(conf, data);
+            return encode_and_save(conf, quant_inds, cmpData, cmpCap);
+        }
 
-            return cmpSize;
+        /**
+         * worst-case size of compress(), known before compression
+         * requires size_bound() from the decomposition (bound of its save(), without unpredictable values)
+         * and from the encoder (bound of its save() + encode(), with unpredictable values as raw bits of symbol 0)
+         */
+        size_t size_bound(const Config &conf) {
+            return lossless.size_bound(payload_bound(conf));
         }
 
         T *decompress(const Config &conf, uchar const *cmpData, size_t cmpSize, T *decData) {
-            size_t bufferCap = conf.num * sizeof(T);
-            auto buffer = (uchar *) malloc(bufferCap);
+            size_t bufferCap = payload_bound(conf);
+            auto buffer = reserve_buffer(bufferCap);
             lossless.decompress(cmpData, cmpSize, buffer, bufferCap);
 
             size_t remaining_length = bufferCap;
@@ -65,26 +73,61 @@ namespace SZ3 {
             decomposition.load(buffer_pos, remaining_length);
             encoder.load(buffer_pos, remaining_length);
             
-            auto quant_inds = encoder.decode(buffer_pos, conf.num);
+            auto quant_inds = encoder.decode_stream(buffer_pos, conf.num);
+            decomposition.decompress_stream(conf, *quant_inds, decData);
             encoder.postprocess_decode();
-
-            free(buffer);
-
-            decomposition.decompress(conf, quant_inds, decData);
             return decData;
         }
 
 
     private:
+        // worst-case size of the data passed to the lossless module
+        size_t payload_bound(const Config &conf) {
+            return decomposition.size_bound(conf) + encoder.size_bound(conf.num, decomposition.get_radius() * 2, 8 * sizeof(T));
+        }
+
+        size_t encode_and_save(const Config &conf, std::vector<int> &quant_inds, uchar *cmpData, size_t cmpCap) {
+            auto &frequency = decomposition.get_frequency();
+            if (frequency.empty()) {
+                encoder.preprocess_encode(quant_inds, decomposition.get_radius() * 2);
+            } else {
+                encoder.preprocess_encode_counted(quant_inds, frequency);
+            }
+            size_t bufferSize = payload_bound(conf);
+
+            auto buffer = reserve_buffer(bufferSize);
+            uchar *buffer_pos = buffer;
+
+            decomposition.save(buffer_pos);
+
+            encoder.save(buffer_pos);
+            encoder.encode(quant_inds, buffer_pos);
+            encoder.postprocess_encode();
+
+            auto cmpSize = lossless.compress(buffer, buffer_pos - buffer, cmpData, cmpCap);
+
+            return cmpSize;
+        }
+
+        uchar *reserve_buffer(size_t size) {
+            std::vector<uchar> &b = buffer ? *buffer : ownBuffer;
+            if (b.size() < size) {
+                b.resize(size);
+            }
+            return b.data();
+        }
+
         Decomposition decomposition;
         Encoder encoder;
         Lossless lossless;
+        std::vector<uchar> *buffer;
+        std::vector<uchar> ownBuffer;
     };
 
     template<class T, uint N, class Decomposition, class Encoder, class Lossless>
     std::shared_ptr<SZGenericCompressor<T, N, Decomposition, Encoder, Lossless>>
-    make_compressor_sz_generic(Decomposition decomposition, Encoder encoder, Lossless lossless) {
-        return std::make_shared<SZGenericCompressor<T, N, Decomposition, Encoder, Lossless>>(decomposition, encoder, lossless);
+    make_compressor_sz_generic(Decomposition decomposition, Encoder encoder, Lossless lossless, std::vector<uchar> *buffer = nullptr) {
+        return std::make_shared<SZGenericCompressor<T, N, Decomposition, Encoder, Lossless>>(decomposition, encoder, lossless, buffer);
     }
 
 
@@ -25,12 +25,17 @@ namespace SZ3 {
     public:
 
 
-        SZIterateCompressor(const Config &conf, Predictor predictor, Quantizer quantizer, Encoder encoder, Lossless lossless) :
+        /**
+         * @param buffer optional scratch space kept by the caller (e.g., SZ3::Context) and reused across calls,
+         *        a buffer owned by this compressor is used if it is nullptr
+         */
+        SZIterateCompressor(const Config &conf, Predictor predictor, Quantizer quantizer, Encoder encoder, Lossless lossless,
+                            std::vector<uchar> *buffer = nullptr) :
                 fallback_predictor(LorenzoPredictor<T, N, 1>(conf.absErrorBound)),
                 predictor(predictor),
                 quantizer(quantizer),
                 block_size(conf.blockSize),
-                num_elements(conf.num), encoder(encoder), lossless(lossless) {
+                num_elements(conf.num), encoder(encoder), lossless(lossless), buffer(buffer) {
             std::copy_n(conf.dims.begin(), N, global_dimensions.begin());
             static_assert(std::is_base_of<concepts::PredictorInterface<T, N>, Predictor>::value,
                           "must implement the predictor interface");
@@ -75,8 +80,8 @@ namespace SZ3 {
 
             encoder.preprocess_encode(quant_inds, quantizer.get_radius() * 2);
 
-            size_t bufferSize = 1.2 * (quantizer.size_est() + encoder.size_est() + sizeof(T) * quant_inds.size());
-            auto buffer = (uchar *) malloc(bufferSize);
+            size_t bufferSize = payload_bound(conf);
+            auto buffer = reserve_buffer(bufferSize);
             uchar *buffer_pos = buffer;
 
             write(conf.num, buffer_pos);
@@ -93,14 +98,18 @@ namespace SZ3 {
             assert(buffer_pos - buffer < bufferSize);
 
             auto cmpSize=lossless.compress(buffer, buffer_pos - buffer, cmpData, cmpCap);
-            free(buffer);
             return cmpSize;
         }
 
+        // worst-case size of compress(), known before compression
+        size_t size_bound(const Config &conf) {
+            return lossless.size_bound(payload_bound(conf));
+        }
+
         T *decompress(const Config &conf, uchar const *cmpData, size_t cmpSize, T *decData) {
 //            Timer timer(true);
-            size_t bufferCap = conf.num * sizeof(T);
-            auto buffer = (uchar *) malloc(bufferCap);
+            size_t bufferCap = payload_bound(conf);
+            auto buffer = reserve_buffer(bufferCap);
             lossless.decompress(cmpData, cmpSize, buffer, bufferCap);
             size_t remaining_length = bufferCap;
             uchar const *buffer_pos = buffer;
@@ -120,15 +129,13 @@ namespace SZ3 {
             encoder.load(buffer_pos, remaining_length);
 
 //            timer.start();
-            auto quant_inds = encoder.decode(buffer_pos, num);
-            encoder.postprocess_decode();
+            // decoded as the elements are recovered
+            auto quant_inds = encoder.decode_stream(buffer_pos, num);
 //            timer.stop("Decoder");
 
-            free(buffer);
 //            lossless.postdecompress_data(buffer);
 
 //            timer.start();
-            int const *quant_inds_pos = (int const *) quant_inds.data();
             std::array<size_t, N> intra_block_dims;
             auto block_range = std::make_shared<multi_dimensional_range<T, N>>(
                     decData, std::begin(global_dimensions), std::end(global_dimensions), block_size, 0);
@@ -148,17 +155,37 @@ namespace SZ3 {
                     predictor_withfallback = &fallback_predictor;
                 }
                 for (auto element = element_range->begin(); element != element_range->end(); ++element) {
-                    *element = quantizer.recover(predictor_withfallback->predict(element), *(quant_inds_pos++));
+                    *element = quantizer.recover(predictor_withfallback->predict(element), quant_inds->next());
                 }
             }
             predictor.postdecompress_data(block_range->begin());
             quantizer.postdecompress_data();
+            encoder.postprocess_decode();
             return decData;
 //            timer.stop("Prediction & Recover");
         }
 
 
     private:
+        // worst-case size of the data passed to the lossless module
+        size_t payload_bound(const Config &conf) {
+            size_t num_blocks = 1;
+            for (uint i = 0; i < N; i++) {
+                num_blocks *= (conf.dims[i] - 1) / block_size + 1;
+            }
+            return sizeof(conf.num) + N * sizeof(size_t) + sizeof(block_size) +
+                   predictor.size_bound(num_blocks) + quantizer.size_bound(0) +
+                   encoder.size_bound(conf.num, quantizer.get_radius() * 2, 8 * sizeof(T));
+        }
+
+        uchar *reserve_buffer(size_t size) {
+            std::vector<uchar> &b = buffer ? *buffer : ownBuffer;
+            if (b.size() < size) {
+                b.resize(size);
+            }
+            return b.data();
+        }
+
         Predictor predictor;
         LorenzoPredictor<T, N, 1> fallback_predictor;
         Quantizer quantizer;
@@ -167,12 +194,16 @@ namespace SZ3 {
         std::array<size_t, N> global_dimensions;
         Encoder encoder;
         Lossless lossless;
+        std::vector<uchar> *buffer;
+        std::vector<uchar> ownBuffer;
     };
 
     template<class T, uint N, class Predictor, class Quantizer, class Encoder, class Lossless>
     std::shared_ptr<SZIterateCompressor<T, N, Predictor, Quantizer, Encoder, Lossless>>
-    make_compressor_sz_iterate(const Config &conf, Predictor predictor, Quantizer quantizer, Encoder encoder, Lossless lossless) {
-        return std::make_shared<SZIterateCompressor<T, N, Predictor, Quantizer, Encoder, Lossless>>(conf, predictor, quantizer, encoder, lossless);
+    make_compressor_sz_iterate(const Config &conf, Predictor predictor, Quantizer quantizer, Encoder encoder, Lossless lossless,
+                               std::vector<uchar> *buffer = nullptr) {
+        return std::make_shared<SZIterateCompressor<T, N, Predictor, Quantizer, Encoder, Lossless>>(conf, predictor, quantizer, encoder,
+                                                                                                    lossless, buffer);
     }
 
 
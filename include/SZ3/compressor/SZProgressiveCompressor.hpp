@@ -0,0 +1,176 @@
+#ifndef SZ_PROGRESSIVE_COMPRESSOR_HPP
+#define SZ_PROGRESSIVE_COMPRESSOR_HPP
+
+#include "SZ3/compressor/Compressor.hpp"
+#include "SZ3/decomposition/Decomposition.hpp"
+#include "SZ3/encoder/Encoder.hpp"
+#include "SZ3/lossless/Lossless.hpp"
+#include "SZ3/utils/FileUtil.hpp"
+#include "SZ3/utils/Config.hpp"
+#include "SZ3/def.hpp"
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * SZProgressiveCompressor is SZGenericCompressor with the levels of a multi-level decomposition
+ * (e.g., InterpolationDecomposition) stored apart, so that the coarse levels can be decompressed alone.
+ * Every level is encoded and compressed by the lossless module on its own.
+ *
+ * Layout: the number of levels, the compressed size of every level (coarsest first), then the compressed levels.
+ */
+
+namespace SZ3 {
+    template<class T, uint N, class Decomposition, class Encoder, class Lossless>
+    class SZProgressiveCompressor : public concepts::CompressorInterface<T> {
+    public:
+
+        /**
+         * @param buffer optional scratch space kept by the caller (e.g., SZ3::Context) and reused across calls,
+         *        a buffer owned by this compressor is used if it is nullptr
+         */
+        SZProgressiveCompressor(Decomposition decomposition, Encoder encoder, Lossless lossless, std::vector<uchar> *buffer = nullptr) :
+                decomposition(decomposition), encoder(encoder), lossless(lossless), buffer(buffer) {
+            static_assert(std::is_base_of<concepts::DecompositionInterface<T, N>, Decomposition>::value,
+                          "must implement the frontend interface");
+            static_assert(std::is_base_of<concepts::EncoderInterface<int>, Encoder>::value,
+                          "must implement the encoder interface");
+            static_assert(std::is_base_of<concepts::LosslessInterface, Lossless>::value,
+                          "must implement the lossless interface");
+            this->decomposition.set_progressive(true);
+        }
+
+        size_t compress(const Config &conf, T *data, uchar *cmpData, size_t cmpCap) {
+
+            std::vector<int> quant_inds = decomposition.compress(conf, data);
+            return encode_and_save(conf, quant_inds, cmpData, cmpCap);
+        }
+
+        size_t compress(const Config &conf, const T *data, uchar *cmpData, size_t cmpCap) {
+
+            std::vector<int> quant_inds = decomposition.compress(conf, data);
+            return encode_and_save(conf, quant_inds, cmpData, cmpCap);
+        }
+
+        // worst-case size of compress(), known before compression
+        size_t size_bound(const Config &conf) {
+            auto sizes = decomposition.level_sizes(conf);
+            size_t bound = (1 + sizes.size()) * sizeof(size_t);
+            for (auto size: sizes) {
+                bound += lossless.size_bound(payload_bound(conf, size));
+            }
+            return bound;
+        }
+
+        T *decompress(const Config &conf, uchar const *cmpData, size_t cmpSize, T *decData) {
+            return decompress_level(conf, cmpData, cmpSize, 0, false, decData);
+        }
+
+        /**
+         * decompress the coarse levels only, the finer levels are not read
+         * @param level number of finest levels left out, see InterpolationDecomposition::decompress_levels
+         * @param upsample false: decData gets the decoded points only; true: decData gets the full grid
+         */
+        T *decompress_level(const Config &conf, uchar const *cmpData, size_t cmpSize, uint level, bool upsample, T *decData) {
+            auto sizes = decomposition.level_sizes(conf);
+            if (cmpSize < (1 + sizes.size()) * sizeof(size_t)) {
+                throw std::invalid_argument("cmpSize too small for the levels of the progressive compression");
+            }
+            size_t levels = 0;
+            read(levels, cmpData);
+            if (levels != sizes.size()) {
+                throw std::invalid_argument("number of levels does not match the data shape");
+            }
+            std::vector<size_t> cmpSize_l(levels);
+            read(cmpSize_l.data(), levels, cmpData);
+            cmpSize -= (1 + levels) * sizeof(size_t);
+            for (size_t k = 0, start = 0; k < levels; k++) {
+                if (cmpSize_l[k] > cmpSize - start) {
+                    throw std::invalid_argument("level size out of the range of the compressed data");
+                }
+                start += cmpSize_l[k];
+            }
+
+            // levels stride 2^level and coarser, the first one is needed in any case
+            size_t used = level < levels ? levels - level : 1;
+            std::vector<int> quant_inds;
+            for (size_t k = 0; k < used; k++) {
+                size_t bufferCap = payload_bound(conf, sizes[k]);
+                auto buffer = reserve_buffer(bufferCap);
+                lossless.decompress(cmpData, cmpSize_l[k], buffer, bufferCap);
+                cmpData += cmpSize_l[k];
+
+                size_t remaining_length = bufferCap;
+                uchar const *buffer_pos = buffer;
+                decomposition.load_level(buffer_pos, remaining_length, k);
+                encoder.load(buffer_pos, remaining_length);
+                auto level_inds = encoder.decode(buffer_pos, sizes[k]);
+                encoder.postprocess_decode();
+                quant_inds.insert(quant_inds.end(), level_inds.begin(), level_inds.end());
+            }
+
+            decomposition.decompress_levels(conf, quant_inds, decData, level, upsample);
+            return decData;
+        }
+
+
+    private:
+        // worst-case size of the data of one level passed to the lossless module
+        size_t payload_bound(const Config &conf, size_t num) {
+            return decomposition.size_bound(conf) + encoder.size_bound(num, decomposition.get_radius() * 2, 8 * sizeof(T));
+        }
+
+        size_t encode_and_save(const Config &conf, std::vector<int> &quant_inds, uchar *cmpData, size_t cmpCap) {
+            auto sizes = decomposition.level_sizes(conf);
+            if (cmpCap < (1 + sizes.size()) * sizeof(size_t)) {
+                throw CapacityError("cmpCap too small for the levels of the progressive compression");
+            }
+            uchar *cmpDataPos = cmpData;
+            write(sizes.size(), cmpDataPos);
+            uchar *cmpSizePos = cmpDataPos;
+            cmpDataPos += sizes.size() * sizeof(size_t);
+
+            std::vector<size_t> cmpSize_l(sizes.size());
+            auto level_begin = quant_inds.begin();
+            for (size_t k = 0; k < sizes.size(); k++) {
+                std::vector<int> level_inds(level_begin, level_begin + sizes[k]);
+                level_begin += sizes[k];
+
+                encoder.preprocess_encode(level_inds, decomposition.get_radius() * 2);
+                auto buffer = reserve_buffer(payload_bound(conf, sizes[k]));
+                uchar *buffer_pos = buffer;
+
+                decomposition.save_level(buffer_pos, k);
+
+                encoder.save(buffer_pos);
+                encoder.encode(level_inds, buffer_pos);
+                encoder.postprocess_encode();
+
+                cmpSize_l[k] = lossless.compress(buffer, buffer_pos - buffer, cmpDataPos, cmpCap - (cmpDataPos - cmpData));
+                cmpDataPos += cmpSize_l[k];
+            }
+            write(cmpSize_l.data(), cmpSize_l.size(), cmpSizePos);
+            return cmpDataPos - cmpData;
+        }
+
+        uchar *reserve_buffer(size_t size) {
+            std::vector<uchar> &b = buffer ? *buffer : ownBuffer;
+            if (b.size() < size) {
+                b.resize(size);
+            }
+            return b.data();
+        }
+
+        Decomposition decomposition;
+        Encoder encoder;
+        Lossless lossless;
+        std::vector<uchar> *buffer;
+        std::vector<uchar> ownBuffer;
+    };
+
+    template<class T, uint N, class Decomposition, class Encoder, class Lossless>
+    std::shared_ptr<SZProgressiveCompressor<T, N, Decomposition, Encoder, Lossless>>
+    make_compressor_sz_progressive(Decomposition decomposition, Encoder encoder, Lossless lossless, std::vector<uchar> *buffer = nullptr) {
+        return std::make_shared<SZProgressiveCompressor<T, N, Decomposition, Encoder, Lossless>>(decomposition, encoder, lossless, buffer);
+    }
+}
+#endif
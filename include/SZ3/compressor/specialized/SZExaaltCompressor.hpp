@@ -118,13 +118,19 @@ namespace SZ3 {
             return cmpSize;
         }
 
+        size_t size_bound(const Config &conf) {
+            return lossless.size_bound(quantizer.size_bound(0)
+                                       + encoder.size_bound(conf.num, 2 * quantizer.get_radius(), 8 * sizeof(T))
+                                       + encoder.size_bound(conf.num, level_num * 2 + 1));
+        }
+
 //        T *decompress(uchar const *lossless_compressed_data, const size_t length) {
         T *decompress(const Config &conf, uchar const *cmpData, size_t cmpSize, T *dec_data) {
 
             size_t bufferCap = conf.num * sizeof(T);
             auto buffer = (uchar *) malloc(bufferCap);
             lossless.decompress(cmpData, cmpSize, buffer, bufferCap);
-            size_t remaining_length = cmpSize;
+            size_t remaining_length = bufferCap;
             uchar const *buffer_pos = buffer;
 
             quantizer.load(buffer_pos, remaining_length);
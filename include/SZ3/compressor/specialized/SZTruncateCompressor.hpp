@@ -46,6 +46,10 @@ namespace SZ3 {
 //            return lossless_data;
         }
         
+        size_t size_bound(const Config &conf) {
+            return lossless.size_bound(conf.num * byteLen);
+        }
+        
         T *decompress(const Config &conf, uchar const *cmpData, size_t cmpSize, T *decData) {
             size_t bufferCap = conf.num * sizeof(T);
             auto buffer = (uchar *) malloc(bufferCap);
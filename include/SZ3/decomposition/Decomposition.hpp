@@ -2,6 +2,7 @@
 #define SZ3_DECOMPOSITION_INTERFACE
 
 #include "SZ3/def.hpp"
+#include "SZ3/encoder/Encoder.hpp"
 #include <vector>
 
 namespace SZ3::concepts {
@@ -45,6 +46,16 @@ namespace SZ3::concepts {
          */
         virtual T *decompress(const Config &conf, std::vector<int> &quant_inds, T *dec_data) = 0;
 
+        /**
+         * same as decompress(), reading the conf.num quantization indices from a stream as they are needed.
+         * By default they are all read first, decompositions reading them in order override it to save that memory.
+         */
+        virtual T *decompress_stream(const Config &conf, SymbolStream<int> &quant_inds, T *dec_data) {
+            std::vector<int> all(conf.num);
+            quant_inds.next(all.data(), all.size());
+            return decompress(conf, all, dec_data);
+        }
+
         /**
          * serialize the frontend and store it to a buffer
          * @param c One large buffer is pre-allocated, and the start location of the serialized frontend in the buffer is indicated by c.
@@ -63,6 +74,15 @@ namespace SZ3::concepts {
 
         virtual int get_radius() { return 0; };
 
+        /**
+         * number of occurrences of each quantization index in [0, 2 * radius) returned by the last compress(),
+         * counted while quantizing so that the encoder does not count them again. Empty if not counted.
+         */
+        virtual const std::vector<size_t> &get_frequency() {
+            static const std::vector<size_t> none;
+            return none;
+        }
+
         virtual void print() {};
 
 //        virtual void clear() {};
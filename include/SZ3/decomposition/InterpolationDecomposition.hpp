@@ -8,60 +8,94 @@
 #include "SZ3/utils/Config.hpp"
 #include "SZ3/utils/FileUtil.hpp"
 #include "SZ3/utils/Interpolators.hpp"
+#include "SZ3/utils/Layout.hpp"
 #include "SZ3/utils/Timer.hpp"
 #include "SZ3/def.hpp"
 #include "SZ3/utils/Config.hpp"
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
+#ifdef _OPENMP
+
+#include <omp.h>
+
+#endif
+
 namespace SZ3 {
     template<class T, uint N, class Quantizer>
     class InterpolationDecomposition : public concepts::DecompositionInterface<T, N> {
      public:
         
-        InterpolationDecomposition(const Config &conf, Quantizer quantizer) : quantizer(quantizer) {
+        InterpolationDecomposition(const Config &conf, Quantizer quantizer) : quantizer(quantizer), parallel(conf.ompInterp) {
             static_assert(std::is_base_of<concepts::QuantizerInterface<T>, Quantizer>::value,
                           "must implement the quatizer interface");
         }
         
         T *decompress(const Config &conf, std::vector<int> &quant_inds, T *dec_data) {
+            this->quant_inds = quant_inds.data();
+            return decompress(dec_data);
+        }
+        
+        // the quantization indices are decoded one block at a time (one level at a time with conf.ompInterp)
+        T *decompress_stream(const Config &conf, SymbolStream<int> &quant_inds, T *dec_data) {
+            quant_stream = &quant_inds;
+            decompress(dec_data);
+            quant_stream = nullptr;
+            quant_window = std::vector<int>();
+            quant_base = 0;
+            return dec_data;
+        }
+        
+        /**
+         * decompress the levels loaded by load_level, from the coarsest one down to the given level
+         * @param level number of finest levels left out, the decoded points are the ones every 2^level along each dimension
+         * @param upsample false: dec_data only gets the decoded points, a grid of (dims - 1) / 2^level + 1 along each dimension
+         *                 true: dec_data gets the full grid, the points of the left out levels are only predicted
+         * The strides set by set_strides apply when dec_data gets the full grid.
+         */
+        T *decompress_levels(const Config &conf, std::vector<int> &quant_inds, T *dec_data, uint level, bool upsample) {
             init();
-            
+            level = std::min<uint>(level, interpolation_level);
+            if (upsample) {
+                // quantization index radius recovers the prediction itself
+                quant_inds.resize(num_elements, quantizer.get_radius());
+            }
             this->quant_inds = quant_inds.data();
-//            lossless.postdecompress_data(buffer);
+            
+            auto dims = global_dimensions;
+            if (!upsample) {
+                std::array<size_t, N> coarse_dims;
+                for (int i = 0; i < N; i++) {
+                    coarse_dims[i] = ((dims[i] - 1) >> level) + 1;
+                }
+                set_dimensions(coarse_dims);
+            }
+            if (upsample || level == 0) {
+                use_strides();
+            }
+            
+            quantizer = level_quantizers[0];
             double eb = quantizer.get_eb();
             
             *dec_data = quantizer.recover(0, this->quant_inds[quant_index++]);
             
-            for (uint level = interpolation_level; level > 0 && level <= interpolation_level; level--) {
-                if (level >= 3) {
+            uint last_level = upsample ? 1 : level + 1;
+            for (uint l = interpolation_level; l >= last_level && l > 0 && l <= interpolation_level; l--) {
+                size_t k = interpolation_level - l;
+                if (k > 0 && k < level_quantizers.size()) {
+                    quantizer = level_quantizers[k];
+                }
+                if (l >= 3) {
                     quantizer.set_eb(eb * eb_ratio);
                 } else {
                     quantizer.set_eb(eb);
                 }
-                size_t stride = 1U << (level - 1);
-                auto inter_block_range = std::make_shared<
-                    multi_dimensional_range<T, N>>(dec_data,
-                                                   std::begin(global_dimensions), std::end(global_dimensions),
-                                                   stride * blocksize, 0);
-                auto inter_begin = inter_block_range->begin();
-                auto inter_end = inter_block_range->end();
-                for (auto block = inter_begin; block != inter_end; ++block) {
-                    auto end_idx = block.get_global_index();
-                    for (int i = 0; i < N; i++) {
-                        end_idx[i] += stride * blocksize;
-                        if (end_idx[i] > global_dimensions[i] - 1) {
-                            end_idx[i] = global_dimensions[i] - 1;
-                        }
-                    }
-                    block_interpolation(dec_data, block.get_global_index(), end_idx, PB_recover,
-                                        interpolators[interpolator_id], direction_sequence_id, stride);
-                    
-                }
+                size_t stride = upsample ? 1U << (l - 1) : 1U << (l - 1 - level);
+                interpolate_level(dec_data, stride, PB_recover);
             }
+            set_dimensions(dims);
             quantizer.postdecompress_data();
-//            timer.stop("Interpolation Decompress");
-            
             return dec_data;
         }
         
@@ -76,44 +110,150 @@ namespace SZ3 {
 
             std::vector<int> quant_inds_vec(num_elements);
             quant_inds = quant_inds_vec.data();
+            frequency.assign(quantizer.get_radius() * 2, 0);
             
             double eb = quantizer.get_eb();
-
-//            quant_inds.push_back(quantizer.quantize_and_overwrite(*data, 0));
-            quant_inds[quant_index++] = quantizer.quantize_and_overwrite(*data, 0);
+            level_quantizers.clear();
+            auto empty_quantizer = quantizer;
 
 //            Timer timer;
 //            timer.start();
             
-            for (uint level = interpolation_level; level > 0 && level <= interpolation_level; level--) {
-                if (level >= 3) {
-                    quantizer.set_eb(eb * eb_ratio);
-                } else {
-                    quantizer.set_eb(eb);
-                }
-                size_t stride = 1U << (level - 1);
+            interpolate_levels(data, 1, PB_predict_overwrite, empty_quantizer, eb);
+            merge_thread_frequency();
+            
+            quantizer.postcompress_data();
+            return quant_inds_vec;
+        }
+        
+        /**
+         * compress given the error bound without modifying data
+         * levels >= 2 only visit points with even coordinates, so they run in place on a compact copy of that sub-grid
+         * (num / 2^N values). Level 1 runs slab by slab along dims[0] in a buffer of (blocksize + 1) rows,
+         * reading the original values from data (strided data is copied into the slab row by row).
+         * The output is identical to compress(conf, T *data).
+         * With conf.ompInterp, the levels >= 2 run in parallel on the sub-grid, and level 1 one row of blocks at a time.
+         */
+        std::vector<int> compress(const Config &conf, const T *data) {
+            std::copy_n(conf.dims.begin(), N, global_dimensions.begin());
+            blocksize = 32;
+            interpolator_id = conf.interpAlgo;
+            direction_sequence_id = conf.interpDirection;
+            
+            init();
+            
+            std::vector<int> quant_inds_vec(num_elements);
+            quant_inds = quant_inds_vec.data();
+            frequency.assign(quantizer.get_radius() * 2, 0);
+            
+            double eb = quantizer.get_eb();
+            auto dims = global_dimensions;
+            auto offsets = dimension_offsets;
+            if (!strides.empty()) {
+                std::copy_n(strides.begin(), N, offsets.begin());
+            }
+            std::array<size_t, N> coarse_dims;
+            for (int i = 0; i < N; i++) {
+                coarse_dims[i] = (dims[i] + 1) / 2;
+            }
+            set_dimensions(coarse_dims);
+            size_t coarse_row = dimension_offsets[0];
+            std::vector<T> coarse(coarse_dims[0] * coarse_row);
+            for (size_t i = 0; i < coarse_dims[0]; i++) {
+                copy_even_points(coarse_dims, offsets, [&](size_t c, size_t f) {
+                    coarse[i * coarse_row + c] = data[2 * i * offsets[0] + f];
+                });
+            }
+            
+            level_quantizers.clear();
+            auto empty_quantizer = quantizer;
+            
+            interpolate_levels(coarse.data(), 2, PB_predict_overwrite, empty_quantizer, eb);
+            
+            set_dimensions(dims);
+            quantizer.set_eb(eb);
+            if (interpolation_level > 0) {
+                // level 1 blocks never reach outside [x, x + blocksize] along dims[0]
+                size_t slab_rows = std::min<size_t>(blocksize + 1, global_dimensions[0]);
+                std::vector<T> slab(slab_rows * dimension_offsets[0]);
+                size_t slab_begin = 0;
+                bool slab_loaded = false;
+                ori_data = strides.empty() ? data : nullptr;
+                std::vector<size_t> row_start(N, 0), slab_start(N, 0), row_size(dims.begin(), dims.end());
+                std::vector<size_t> slab_strides(dimension_offsets.begin(), dimension_offsets.end());
+                row_size[0] = 1;
                 
+                std::vector<std::array<size_t, N>> begins, ends;
                 auto inter_block_range = std::make_shared<
-                    multi_dimensional_range<T, N>>(data, std::begin(global_dimensions),
-                                                   std::end(global_dimensions),
-                                                   blocksize * stride, 0);
-                
+                    multi_dimensional_range<T, N>>(slab.data(), std::begin(global_dimensions),
+                                                   std::end(global_dimensions), blocksize, 0);
                 auto inter_begin = inter_block_range->begin();
                 auto inter_end = inter_block_range->end();
-                
                 for (auto block = inter_begin; block != inter_end; ++block) {
                     auto end_idx = block.get_global_index();
                     for (int i = 0; i < N; i++) {
-                        end_idx[i] += blocksize * stride;
+                        end_idx[i] += blocksize;
                         if (end_idx[i] > global_dimensions[i] - 1) {
                             end_idx[i] = global_dimensions[i] - 1;
                         }
                     }
-                    
-                    block_interpolation(data, block.get_global_index(), end_idx, PB_predict_overwrite,
-                                        interpolators[interpolator_id], direction_sequence_id, stride);
+                    begins.push_back(block.get_global_index());
+                    ends.push_back(end_idx);
+                }
+                
+                // the blocks of one row along dims[0] share the slab, with conf.ompInterp they run on all threads
+                for (size_t row = 0, next = 0; row < begins.size(); row = next) {
+                    while (next < begins.size() && begins[next][0] == begins[row][0]) {
+                        next++;
+                    }
+                    auto &begin_idx = begins[row];
+                    auto &end_idx = ends[row];
+                    if (!slab_loaded || begin_idx[0] != slab_begin) {
+                        size_t first_row = 0;
+                        if (slab_loaded) {
+                            // the first row was finished as the last row of the previous slab
+                            std::copy_n(slab.begin() + (begin_idx[0] - slab_begin) * dimension_offsets[0],
+                                        dimension_offsets[0], slab.begin());
+                            first_row = 1;
+                        }
+                        for (size_t r = first_row; r <= end_idx[0] - begin_idx[0]; r++) {
+                            size_t x = begin_idx[0] + r;
+                            if (!strides.empty()) {
+                                // strided data is loaded into the slab, and overwritten there by the reconstructed values
+                                row_start[0] = x;
+                                slab_start[0] = r;
+                                copy_box(data, strides, row_start, slab.data(), slab_strides, slab_start, row_size);
+                            }
+                            if (x % 2 == 0) {
+                                copy_even_points(coarse_dims, dimension_offsets, [&](size_t c, size_t f) {
+                                    slab[r * dimension_offsets[0] + f] = coarse[x / 2 * coarse_row + c];
+                                });
+                            }
+                        }
+                        slab_begin = begin_idx[0];
+                        slab_loaded = true;
+                        data_offset = slab_begin * dimension_offsets[0];
+                    }
+#ifdef _OPENMP
+                    if (next - row > 1 && run_parallel()) {
+                        std::vector<std::array<size_t, N>> row_begins(begins.begin() + row, begins.begin() + next);
+                        std::vector<std::array<size_t, N>> row_ends(ends.begin() + row, ends.begin() + next);
+                        interpolate_level_omp(slab.data(), row_begins, row_ends, 1, PB_predict_overwrite);
+                        continue;
+                    }
+#endif
+                    Lane lane{quantizer, quant_index, frequency.data(), {}};
+                    for (size_t b = row; b < next; b++) {
+                        block_interpolation(lane, slab.data(), begins[b], ends[b], PB_predict_overwrite,
+                                            direction_sequence_id, 1);
+                    }
+                    quant_index = lane.quant_index;
                 }
+                ori_data = nullptr;
+                data_offset = 0;
+                end_level(empty_quantizer, eb);
             }
+            merge_thread_frequency();
             
             quantizer.postcompress_data();
             return quant_inds_vec;
@@ -136,6 +276,77 @@ namespace SZ3 {
             
             quantizer.load(c, remaining_length);
         }
+        
+        // worst-case size of save(), the unpredictable values are bounded together with the quantization indices
+        size_t size_bound(const Config &conf) {
+            return N * sizeof(size_t) + sizeof(blocksize) + sizeof(interpolator_id) + sizeof(direction_sequence_id) +
+                   quantizer.size_bound(0);
+        }
+        
+        int get_radius() { return quantizer.get_radius(); }
+        
+        // number of occurrences of each quantization index returned by the last compress, counted as they are quantized
+        const std::vector<size_t> &get_frequency() { return frequency; }
+        
+        /**
+         * layout of the data passed to compress(conf, const T *data) and of the output of decompress,
+         * see Layout.hpp. Empty (the default) is the contiguous layout.
+         */
+        void set_strides(const std::vector<size_t> &s) { strides = s; }
+        
+        /**
+         * keep the unpredictable values of every level apart during compression,
+         * so that each level can be saved with save_level and the coarse ones decompressed alone
+         */
+        void set_progressive(bool p) { progressive = p; }
+        
+        /**
+         * number of quantization indices of every level, from the coarsest one (which also holds the first point)
+         * to the finest one. A level of stride s holds the points on the grid of spacing s that are not on the grid of spacing 2s.
+         */
+        std::vector<size_t> level_sizes(const Config &conf) const {
+            uint levels = 0;
+            for (int i = 0; i < N; i++) {
+                levels = std::max(levels, (uint) ceil(log2(conf.dims[i])));
+            }
+            // points on the grid of spacing 2^l
+            auto grid_num = [&](uint l) {
+                size_t num = 1;
+                for (int i = 0; i < N; i++) {
+                    num *= ((conf.dims[i] - 1) >> l) + 1;
+                }
+                return num;
+            };
+            std::vector<size_t> sizes = {grid_num(levels > 0 ? levels - 1 : 0)};
+            for (uint l = levels - 1; l > 0 && l < levels; l--) {
+                sizes.push_back(grid_num(l - 1) - grid_num(l));
+            }
+            return sizes;
+        }
+        
+        // save the k-th level (coarsest first) of a progressive compression, the first one also holds the settings
+        void save_level(uchar *&c, size_t k) {
+            if (k == 0) {
+                write(global_dimensions.data(), N, c);
+                write(blocksize, c);
+                write(interpolator_id, c);
+                write(direction_sequence_id, c);
+            }
+            level_quantizers[k].save(c);
+        }
+        
+        // load the k-th level saved by save_level, levels are loaded in order starting from the first one
+        void load_level(const uchar *&c, size_t &remaining_length, size_t k) {
+            if (k == 0) {
+                read(global_dimensions.data(), N, c, remaining_length);
+                read(blocksize, c, remaining_length);
+                read(interpolator_id, c, remaining_length);
+                read(direction_sequence_id, c, remaining_length);
+                level_quantizers.clear();
+            }
+            level_quantizers.push_back(quantizer);
+            level_quantizers.back().load(c, remaining_length);
+        }
      
      private:
         
@@ -155,10 +366,7 @@ namespace SZ3 {
                 num_elements *= global_dimensions[i];
             }
             
-            dimension_offsets[N - 1] = 1;
-            for (int i = N - 2; i >= 0; i--) {
-                dimension_offsets[i] = dimension_offsets[i + 1] * global_dimensions[i + 1];
-            }
+            set_dimensions(global_dimensions);
             
             dimension_sequences = std::vector<std::array<int, N>>();
             auto sequence = std::array<int, N>();
@@ -170,50 +378,383 @@ namespace SZ3 {
             } while (std::next_permutation(sequence.begin(), sequence.end()));
         }
         
-        inline void quantize(size_t idx, T &d, T pred) {
-            quant_inds[quant_index++] = (quantizer.quantize_and_overwrite(d, pred));
+        void set_dimensions(const std::array<size_t, N> &dims) {
+            global_dimensions = dims;
+            dimension_offsets[N - 1] = 1;
+            for (int i = N - 2; i >= 0; i--) {
+                dimension_offsets[i] = dimension_offsets[i + 1] * global_dimensions[i + 1];
+            }
+        }
+        
+        /**
+         * visit the points with even coordinates in dims[1..N-1] of one row along dims[0]
+         * @param coarse_dims dimensions of the compact grid holding only the points with even coordinates
+         * @param offsets dimension offsets of the full grid
+         * @param func called with (offset in the compact row, offset in the full row)
+         */
+        template<class Func>
+        void copy_even_points(const std::array<size_t, N> &coarse_dims, const std::array<size_t, N> &offsets, Func &&func) {
+            std::array<size_t, N> idx{};
+            size_t coarse_row = 1;
+            for (int i = 1; i < N; i++) {
+                coarse_row *= coarse_dims[i];
+            }
+            for (size_t c = 0; c < coarse_row; c++) {
+                size_t f = 0;
+                for (int i = 1; i < N; i++) {
+                    f += 2 * idx[i] * offsets[i];
+                }
+                func(c, f);
+                for (int i = N - 1; i > 0; i--) {
+                    if (++idx[i] < coarse_dims[i]) {
+                        break;
+                    }
+                    idx[i] = 0;
+                }
+            }
+        }
+        
+        T *decompress(T *dec_data) {
+            init();
+            use_strides();
+            
+//            lossless.postdecompress_data(buffer);
+            double eb = quantizer.get_eb();
+            
+            interpolate_levels(dec_data, 1, PB_recover, quantizer, eb);
+            quantizer.postdecompress_data();
+//            timer.stop("Interpolation Decompress");
+            
+            return dec_data;
+        }
+        
+        /**
+         * with a stream of quantization indices (see decompress_stream), decode the num ones from begin for the next points.
+         * Indices i of [begin, begin + num) are then at quant_inds[i - quant_base].
+         */
+        void fetch_quant_inds(size_t begin, size_t num) {
+            if (quant_stream) {
+                quant_window.resize(num);
+                quant_stream->next(quant_window.data(), num);
+                quant_inds = quant_window.data();
+                quant_base = begin;
+            }
+        }
+        
+        /**
+         * interpolate the levels from interpolation_level down to the given one, after the first point.
+         * data holds the points every 2^(level-1) along each dimension of the full grid, described by
+         * global_dimensions and dimension_offsets, so the given level runs on it with stride 1.
+         * The coarser levels only visit the points with even coordinates of data. With N >= 2 they run on a compact copy
+         * of these points (recursively, every level gets its own grid), instead of reading one value per cache line or page
+         * of data along the slower dimensions. The points are visited in the same order with the same values,
+         * so the output does not change.
+         */
+        void interpolate_levels(T *data, uint level, const PredictorBehavior pb, const Quantizer &empty_quantizer, double eb) {
+            if (N >= 2 && level < interpolation_level) {
+                auto dims = global_dimensions;
+                auto offsets = dimension_offsets;
+                std::array<size_t, N> coarse_dims;
+                for (int i = 0; i < N; i++) {
+                    coarse_dims[i] = (dims[i] + 1) / 2;
+                }
+                set_dimensions(coarse_dims);
+                size_t coarse_row = dimension_offsets[0];
+                std::vector<T> coarse(coarse_dims[0] * coarse_row);
+                if (pb != PB_recover) {
+                    for (size_t i = 0; i < coarse_dims[0]; i++) {
+                        copy_even_points(coarse_dims, offsets, [&](size_t c, size_t f) {
+                            coarse[i * coarse_row + c] = data[2 * i * offsets[0] + f];
+                        });
+                    }
+                }
+                interpolate_levels(coarse.data(), level + 1, pb, empty_quantizer, eb);
+                for (size_t i = 0; i < coarse_dims[0]; i++) {
+                    copy_even_points(coarse_dims, offsets, [&](size_t c, size_t f) {
+                        data[2 * i * offsets[0] + f] = coarse[i * coarse_row + c];
+                    });
+                }
+                global_dimensions = dims;
+                dimension_offsets = offsets;
+            } else {
+                if (pb == PB_recover) {
+                    fetch_quant_inds(quant_index, 1);
+                    *data = quantizer.recover(0, quant_inds[quant_index++ - quant_base]);
+                } else {
+                    quant_inds[quant_index] = quantizer.quantize_and_overwrite(*data, 0);
+                    frequency[quant_inds[quant_index++]]++;
+                    if (interpolation_level == 0) {
+                        end_level(empty_quantizer, eb);
+                    }
+                }
+                for (uint l = interpolation_level; l > level; l--) {
+                    interpolate_level(data, l, 1U << (l - level), pb, empty_quantizer, eb);
+                }
+            }
+            if (level <= interpolation_level) {
+                interpolate_level(data, level, 1, pb, empty_quantizer, eb);
+            }
+        }
+        
+        // interpolate the given level, whose points are at the given stride in data
+        void interpolate_level(T *data, uint level, size_t stride, const PredictorBehavior pb,
+                               const Quantizer &empty_quantizer, double eb) {
+            if (level >= 3) {
+                quantizer.set_eb(eb * eb_ratio);
+            } else {
+                quantizer.set_eb(eb);
+            }
+            interpolate_level(data, stride, pb);
+            if (pb != PB_recover) {
+                end_level(empty_quantizer, eb);
+            }
+        }
+        
+        // add the counts of the openmp threads to frequency
+        void merge_thread_frequency() {
+            for (auto &f: thread_frequency) {
+                for (size_t i = 0; i < frequency.size(); i++) {
+                    frequency[i] += f[i];
+                }
+            }
+            thread_frequency.clear();
+        }
+        
+        // address the data with the strides of its layout instead of its dimensions
+        void use_strides() {
+            if (!strides.empty()) {
+                std::copy_n(strides.begin(), N, dimension_offsets.begin());
+            }
+        }
+        
+        // with progressive on, the quantizer of a finished level is kept and the next level starts with an empty one
+        void end_level(const Quantizer &empty_quantizer, double eb) {
+            if (progressive) {
+                quantizer.set_eb(eb);
+                level_quantizers.push_back(quantizer);
+                quantizer = empty_quantizer;
+            }
+        }
+        
+        // a point quantized (or recovered) in a batch that may be unpredictable, see interpolate_batch
+        struct Unpredictable {
+            size_t quant_index;
+            size_t offset;
+            T pred;
+        };
+        
+        // where the points interpolated by one task get their quantization indices and unpredictable values
+        struct Lane {
+            Quantizer &quantizer;
+            size_t quant_index;
+            size_t *frequency; // counts of the quantization indices when compressing, see get_frequency
+            std::vector<Unpredictable> unpredictable;
+        };
+        
+        // number of points predicted at once by interpolate_batch, in arrays on the stack
+        static constexpr size_t batch_size = 64;
+        
+        inline void quantize(Lane &lane, size_t idx, T &d, T pred) {
+            if (ori_data) {
+                quant_inds[lane.quant_index] = lane.quantizer.quantize_and_overwrite(ori_data[data_offset + idx], pred, d);
+            } else {
+                quant_inds[lane.quant_index] = (lane.quantizer.quantize_and_overwrite(d, pred));
+            }
+            lane.frequency[quant_inds[lane.quant_index++]]++;
         }
         
-        inline void recover(size_t idx, T &d, T pred) {
-            d = quantizer.recover(pred, quant_inds[quant_index++]);
+        inline void recover(Lane &lane, size_t idx, T &d, T pred) {
+            d = lane.quantizer.recover(pred, quant_inds[lane.quant_index++ - quant_base]);
         };
         
-        double block_interpolation_1d(T *data, size_t begin, size_t end, size_t stride,
-                                      const std::string &interp_func,
+        /**
+         * predict and quantize (or recover) count points of the same kind at once: point k is data[offset + k * step],
+         * predicted by predict(pointer to the point), and takes quantization index quant_offset + k * quant_step.
+         * The points are gathered into arrays so that the predictions and the quantization are vectorized,
+         * the ones that may be unpredictable are left in lane.unpredictable for resolve_unpredictable.
+         * Only for floating-point data, the points must not depend on each other.
+         */
+        template<class Predict>
+        void interpolate_batch(Lane &lane, T *data, size_t offset, size_t step, size_t count,
+                               size_t quant_offset, size_t quant_step, const PredictorBehavior pb, Predict &&predict) {
+            // every other point, as in the lines of the finest level along the last dimension, is the most common case
+            if (step == 2) {
+                interpolate_batch<2>(lane, data, offset, step, count, quant_offset, quant_step, pb, predict);
+            } else {
+                interpolate_batch<0>(lane, data, offset, step, count, quant_offset, quant_step, pb, predict);
+            }
+        }
+        
+        // Step > 0 is the step known at compile time, so that the gathers and scatters are vectorized
+        template<size_t Step, class Predict>
+        void interpolate_batch(Lane &lane, T *data, size_t offset, size_t step, size_t count,
+                               size_t quant_offset, size_t quant_step, const PredictorBehavior pb, Predict &&predict) {
+            if (Step > 0) {
+                step = Step;
+            }
+            T pred[batch_size], ori[batch_size], dest[batch_size];
+            int quant[batch_size];
+            for (size_t k0 = 0; k0 < count; k0 += batch_size) {
+                size_t n = std::min(batch_size, count - k0);
+                T *p = data + offset + k0 * step;
+                int *q = quant_inds + (quant_offset - quant_base) + k0 * quant_step;
+#pragma omp simd
+                for (size_t k = 0; k < n; k++) {
+                    pred[k] = predict(p + k * step);
+                }
+                size_t unpred_num;
+                if (pb == PB_recover) {
+                    for (size_t k = 0; k < n; k++) {
+                        quant[k] = q[k * quant_step];
+                    }
+                    lane.quantizer.recover_batch(pred, quant, dest, n);
+                    unpred_num = std::count(quant, quant + n, 0);
+                } else {
+                    const T *o = ori_data ? ori_data + data_offset + (p - data) : p;
+#pragma omp simd
+                    for (size_t k = 0; k < n; k++) {
+                        ori[k] = o[k * step];
+                    }
+                    unpred_num = lane.quantizer.quantize_batch(ori, pred, dest, quant, n);
+                    for (size_t k = 0; k < n; k++) {
+                        q[k * quant_step] = quant[k];
+                        lane.frequency[quant[k]]++;
+                    }
+                }
+#pragma omp simd
+                for (size_t k = 0; k < n; k++) {
+                    p[k * step] = dest[k];
+                }
+                for (size_t k = 0; unpred_num > 0 && k < n; k++) {
+                    if (quant[k] == 0) {
+                        lane.unpredictable.push_back({quant_offset + (k0 + k) * quant_step, (p - data) + k * step, pred[k]});
+                    }
+                }
+            }
+        }
+        
+        // quantize (or recover) the points left by interpolate_batch one by one, in the order of their quantization indices
+        void resolve_unpredictable(Lane &lane, T *data, const PredictorBehavior pb) {
+            std::sort(lane.unpredictable.begin(), lane.unpredictable.end(),
+                      [](const Unpredictable &a, const Unpredictable &b) { return a.quant_index < b.quant_index; });
+            for (auto &u: lane.unpredictable) {
+                T &d = data[u.offset];
+                if (pb == PB_recover) {
+                    d = lane.quantizer.recover(u.pred, quant_inds[u.quant_index - quant_base]);
+                } else {
+                    if (ori_data) {
+                        quant_inds[u.quant_index] = lane.quantizer.quantize_and_overwrite(ori_data[data_offset + u.offset], u.pred, d);
+                    } else {
+                        quant_inds[u.quant_index] = lane.quantizer.quantize_and_overwrite(d, u.pred);
+                    }
+                    // counted as 0 by interpolate_batch
+                    lane.frequency[0]--;
+                    lane.frequency[quant_inds[u.quant_index]]++;
+                }
+            }
+            lane.unpredictable.clear();
+        }
+        
+        // number of points predicted in the main loop of a line of n points, see block_interpolation_1d
+        template<bool Cubic>
+        static size_t line_loop_size(size_t n) {
+            if (!Cubic || n < 5) {
+                return (n - 1) / 2;
+            }
+            return n >= 7 ? (n - 7) / 2 + 1 : 0;
+        }
+        
+        /**
+         * predict count lines of n points side by side, the points of a line are at distance stride from data[begin],
+         * the lines at distance lane_step from each other. Every other point of a line is predicted from the points
+         * in between, so the points do not depend on each other: they are batched across the lines, or along the line
+         * if there is a single one. The quantization indices follow the order of block_interpolation_1d line by line,
+         * starting from lane.quant_index.
+         */
+        template<bool Cubic>
+        void interpolate_lines(Lane &lane, T *data, size_t begin, size_t n, size_t stride, size_t count,
+                               size_t lane_step, const PredictorBehavior pb) {
+            size_t stride3x = 3 * stride;
+            size_t stride5x = 5 * stride;
+            size_t line_size = n / 2;
+            size_t loop = line_loop_size<Cubic>(n);
+            // m points of every line at index i, i + 2, ..., taking the places ordinal, ordinal + 1, ... in their line
+            auto points = [&](size_t i, size_t ordinal, size_t m, auto &&predict) {
+                if (count == 1) {
+                    interpolate_batch(lane, data, begin + i * stride, 2 * stride, m, lane.quant_index + ordinal, 1, pb, predict);
+                } else {
+                    for (size_t j = 0; j < m; j++) {
+                        interpolate_batch(lane, data, begin + (i + 2 * j) * stride, lane_step, count,
+                                          lane.quant_index + ordinal + j, line_size, pb, predict);
+                    }
+                }
+            };
+            if (!Cubic || n < 5) {
+                points(1, 0, loop, [&](const T *d) { return interp_linear(*(d - stride), *(d + stride)); });
+                if (n % 2 == 0) {
+                    if (n < 4) {
+                        points(n - 1, loop, 1, [&](const T *d) { return *(d - stride); });
+                    } else {
+                        points(n - 1, loop, 1, [&](const T *d) { return interp_linear1(*(d - stride3x), *(d - stride)); });
+                    }
+                }
+            } else {
+                points(3, 0, loop, [&](const T *d) {
+                    return interp_cubic(*(d - stride3x), *(d - stride), *(d + stride), *(d + stride3x));
+                });
+                points(1, loop, 1, [&](const T *d) { return interp_quad_1(*(d - stride), *(d + stride), *(d + stride3x)); });
+                points(3 + 2 * loop, loop + 1, 1, [&](const T *d) {
+                    return interp_quad_2(*(d - stride3x), *(d - stride), *(d + stride));
+                });
+                if (n % 2 == 0) {
+                    points(n - 1, loop + 2, 1, [&](const T *d) {
+                        return interp_quad_3(*(d - stride5x), *(d - stride3x), *(d - stride));
+                    });
+                }
+            }
+            resolve_unpredictable(lane, data, pb);
+            lane.quant_index += count * line_size;
+        }
+        
+
+        // predict a line point by point, for data other than floating-point
+        template<bool Cubic>
+        double block_interpolation_1d(Lane &lane, T *data, size_t begin, size_t end, size_t stride,
                                       const PredictorBehavior pb) {
             size_t n = (end - begin) / stride + 1;
             if (n <= 1) {
                 return 0;
             }
+            begin -= data_offset;
             double predict_error = 0;
             
             size_t stride3x = 3 * stride;
             size_t stride5x = 5 * stride;
-            if (interp_func == "linear" || n < 5) {
+            if (!Cubic || n < 5) {
                 if (pb == PB_predict_overwrite) {
                     for (size_t i = 1; i + 1 < n; i += 2) {
                         T *d = data + begin + i * stride;
-                        quantize(d - data, *d, interp_linear(*(d - stride), *(d + stride)));
+                        quantize(lane, d - data, *d, interp_linear(*(d - stride), *(d + stride)));
                     }
                     if (n % 2 == 0) {
                         T *d = data + begin + (n - 1) * stride;
                         if (n < 4) {
-                            quantize(d - data, *d, *(d - stride));
+                            quantize(lane, d - data, *d, *(d - stride));
                         } else {
-                            quantize(d - data, *d, interp_linear1(*(d - stride3x), *(d - stride)));
+                            quantize(lane, d - data, *d, interp_linear1(*(d - stride3x), *(d - stride)));
                         }
                     }
                 } else {
                     for (size_t i = 1; i + 1 < n; i += 2) {
                         T *d = data + begin + i * stride;
-                        recover(d - data, *d, interp_linear(*(d - stride), *(d + stride)));
+                        recover(lane, d - data, *d, interp_linear(*(d - stride), *(d + stride)));
                     }
                     if (n % 2 == 0) {
                         T *d = data + begin + (n - 1) * stride;
                         if (n < 4) {
-                            recover(d - data, *d, *(d - stride));
+                            recover(lane, d - data, *d, *(d - stride));
                         } else {
-                            recover(d - data, *d, interp_linear1(*(d - stride3x), *(d - stride)));
+                            recover(lane, d - data, *d, interp_linear1(*(d - stride3x), *(d - stride)));
                         }
                     }
                 }
@@ -224,17 +765,17 @@ namespace SZ3 {
                     size_t i;
                     for (i = 3; i + 3 < n; i += 2) {
                         d = data + begin + i * stride;
-                        quantize(d - data, *d,
+                        quantize(lane, d - data, *d,
                                  interp_cubic(*(d - stride3x), *(d - stride), *(d + stride), *(d + stride3x)));
                     }
                     d = data + begin + stride;
-                    quantize(d - data, *d, interp_quad_1(*(d - stride), *(d + stride), *(d + stride3x)));
+                    quantize(lane, d - data, *d, interp_quad_1(*(d - stride), *(d + stride), *(d + stride3x)));
                     
                     d = data + begin + i * stride;
-                    quantize(d - data, *d, interp_quad_2(*(d - stride3x), *(d - stride), *(d + stride)));
+                    quantize(lane, d - data, *d, interp_quad_2(*(d - stride3x), *(d - stride), *(d + stride)));
                     if (n % 2 == 0) {
                         d = data + begin + (n - 1) * stride;
-                        quantize(d - data, *d, interp_quad_3(*(d - stride5x), *(d - stride3x), *(d - stride)));
+                        quantize(lane, d - data, *d, interp_quad_3(*(d - stride5x), *(d - stride3x), *(d - stride)));
                     }
                     
                 } else {
@@ -243,18 +784,18 @@ namespace SZ3 {
                     size_t i;
                     for (i = 3; i + 3 < n; i += 2) {
                         d = data + begin + i * stride;
-                        recover(d - data, *d, interp_cubic(*(d - stride3x), *(d - stride), *(d + stride), *(d + stride3x)));
+                        recover(lane, d - data, *d, interp_cubic(*(d - stride3x), *(d - stride), *(d + stride), *(d + stride3x)));
                     }
                     d = data + begin + stride;
                     
-                    recover(d - data, *d, interp_quad_1(*(d - stride), *(d + stride), *(d + stride3x)));
+                    recover(lane, d - data, *d, interp_quad_1(*(d - stride), *(d + stride), *(d + stride3x)));
                     
                     d = data + begin + i * stride;
-                    recover(d - data, *d, interp_quad_2(*(d - stride3x), *(d - stride), *(d + stride)));
+                    recover(lane, d - data, *d, interp_quad_2(*(d - stride3x), *(d - stride), *(d + stride)));
                     
                     if (n % 2 == 0) {
                         d = data + begin + (n - 1) * stride;
-                        recover(d - data, *d, interp_quad_3(*(d - stride5x), *(d - stride3x), *(d - stride)));
+                        recover(lane, d - data, *d, interp_quad_3(*(d - stride5x), *(d - stride3x), *(d - stride)));
                     }
                 }
             }
@@ -262,166 +803,246 @@ namespace SZ3 {
             return predict_error;
         }
         
-        template<uint NN = N>
-        typename std::enable_if<NN == 1, double>::type
-        block_interpolation(T *data, std::array<size_t, N> begin, std::array<size_t, N> end, const PredictorBehavior pb,
-                            const std::string &interp_func, const int direction, size_t stride = 1) {
-            return block_interpolation_1d(data, begin[0], end[0], stride, interp_func, pb);
-        }
-        
-        template<uint NN = N>
-        typename std::enable_if<NN == 2, double>::type
-        block_interpolation(T *data, std::array<size_t, N> begin, std::array<size_t, N> end, const PredictorBehavior pb,
-                            const std::string &interp_func, const int direction, size_t stride = 1) {
-            double predict_error = 0;
-            size_t stride2x = stride * 2;
+        /**
+         * interpolate the lines of a block along dims[pass], where dims is the direction sequence.
+         * The lines go through the points already known along dims[0..pass-1] and the points of the coarser levels
+         * along dims[pass+1..N-1], so they only read points of the coarser levels and of the earlier passes.
+         * A block leaves the points on its lower faces to the neighboring blocks, unless they are on the border of the data.
+         * The lines side by side along the last of the other dimensions are batched (see interpolate_lines)
+         * if they are closer to each other than the points of a line.
+         */
+        template<bool Cubic>
+        double block_interpolation_pass(Lane &lane, T *data, const std::array<size_t, N> &begin, const std::array<size_t, N> &end,
+                                        uint pass, const PredictorBehavior pb, const int direction, size_t stride) {
             const std::array<int, N> dims = dimension_sequences[direction];
-            for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride2x : 0); j <= end[dims[1]]; j += stride2x) {
-                size_t begin_offset = begin[dims[0]] * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]];
-                predict_error += block_interpolation_1d(data, begin_offset,
-                                                        begin_offset +
-                                                            (end[dims[0]] - begin[dims[0]]) * dimension_offsets[dims[0]],
-                                                        stride * dimension_offsets[dims[0]], interp_func, pb);
-            }
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                size_t begin_offset = i * dimension_offsets[dims[0]] + begin[dims[1]] * dimension_offsets[dims[1]];
-                predict_error += block_interpolation_1d(data, begin_offset,
-                                                        begin_offset +
-                                                            (end[dims[1]] - begin[dims[1]]) * dimension_offsets[dims[1]],
-                                                        stride * dimension_offsets[dims[1]], interp_func, pb);
+            std::array<size_t, N> first, step, idx;
+            for (uint i = 0; i < N; i++) {
+                step[i] = i < pass ? stride : stride * 2;
+                first[i] = begin[dims[i]] ? begin[dims[i]] + step[i] : 0;
+                if (i != pass && first[i] > end[dims[i]]) {
+                    return 0;
+                }
+            }
+            first[pass] = begin[dims[pass]];
+            idx = first;
+            
+            size_t n = (end[dims[pass]] - begin[dims[pass]]) / stride + 1;
+            if (n <= 1) {
+                return 0;
+            }
+            size_t line_stride = stride * dimension_offsets[dims[pass]];
+            int batched = -1;
+            size_t count = 1, lane_step = 0;
+            if (std::is_floating_point<T>::value) {
+                batched = pass == N - 1 ? (int) N - 2 : (int) N - 1;
+                if (batched >= 0) {
+                    lane_step = step[batched] * dimension_offsets[dims[batched]];
+                    count = (end[dims[batched]] - first[batched]) / step[batched] + 1;
+                }
+                if (batched < 0 || lane_step >= 2 * line_stride) {
+                    batched = -1;
+                    count = 1;
+                }
+            }
+            
+            double predict_error = 0;
+            while (true) {
+                size_t begin_offset = 0;
+                for (uint i = 0; i < N; i++) {
+                    begin_offset += idx[i] * dimension_offsets[dims[i]];
+                }
+                if (std::is_floating_point<T>::value) {
+                    interpolate_lines<Cubic>(lane, data, begin_offset - data_offset, n, line_stride, count, lane_step, pb);
+                } else {
+                    predict_error += block_interpolation_1d<Cubic>(lane, data, begin_offset,
+                                                                   begin_offset + (n - 1) * line_stride, line_stride, pb);
+                }
+                int i = N - 1;
+                for (; i >= 0; i--) {
+                    if (i == (int) pass || i == batched) {
+                        continue;
+                    }
+                    idx[i] += step[i];
+                    if (idx[i] <= end[dims[i]]) {
+                        break;
+                    }
+                    idx[i] = first[i];
+                }
+                if (i < 0) {
+                    break;
+                }
             }
             return predict_error;
         }
         
-        template<uint NN = N>
-        typename std::enable_if<NN == 3, double>::type
-        block_interpolation(T *data, std::array<size_t, N> begin, std::array<size_t, N> end, const PredictorBehavior pb,
-                            const std::string &interp_func, const int direction, size_t stride = 1) {
-            double predict_error = 0;
-            size_t stride2x = stride * 2;
+        double block_interpolation_pass(Lane &lane, T *data, const std::array<size_t, N> &begin, const std::array<size_t, N> &end,
+                                        uint pass, const PredictorBehavior pb, const int direction, size_t stride) {
+            if (interpolator_id == INTERP_ALGO_LINEAR) {
+                return block_interpolation_pass<false>(lane, data, begin, end, pass, pb, direction, stride);
+            }
+            return block_interpolation_pass<true>(lane, data, begin, end, pass, pb, direction, stride);
+        }
+        
+        // number of points interpolated by block_interpolation_pass
+        size_t block_interpolation_pass_size(const std::array<size_t, N> &begin, const std::array<size_t, N> &end,
+                                             uint pass, const int direction, size_t stride) const {
             const std::array<int, N> dims = dimension_sequences[direction];
-            for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride2x : 0); j <= end[dims[1]]; j += stride2x) {
-                for (size_t k = (begin[dims[2]] ? begin[dims[2]] + stride2x : 0); k <= end[dims[2]]; k += stride2x) {
-                    size_t begin_offset = begin[dims[0]] * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]] +
-                        k * dimension_offsets[dims[2]];
-                    predict_error += block_interpolation_1d(data, begin_offset,
-                                                            begin_offset +
-                                                                (end[dims[0]] - begin[dims[0]]) *
-                                                                    dimension_offsets[dims[0]],
-                                                            stride * dimension_offsets[dims[0]], interp_func, pb);
-                }
-            }
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                for (size_t k = (begin[dims[2]] ? begin[dims[2]] + stride2x : 0); k <= end[dims[2]]; k += stride2x) {
-                    size_t begin_offset = i * dimension_offsets[dims[0]] + begin[dims[1]] * dimension_offsets[dims[1]] +
-                        k * dimension_offsets[dims[2]];
-                    predict_error += block_interpolation_1d(data, begin_offset,
-                                                            begin_offset +
-                                                                (end[dims[1]] - begin[dims[1]]) *
-                                                                    dimension_offsets[dims[1]],
-                                                            stride * dimension_offsets[dims[1]], interp_func, pb);
-                }
-            }
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride : 0); j <= end[dims[1]]; j += stride) {
-                    size_t begin_offset = i * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]] +
-                        begin[dims[2]] * dimension_offsets[dims[2]];
-                    predict_error += block_interpolation_1d(data, begin_offset,
-                                                            begin_offset +
-                                                                (end[dims[2]] - begin[dims[2]]) *
-                                                                    dimension_offsets[dims[2]],
-                                                            stride * dimension_offsets[dims[2]], interp_func, pb);
+            // every other point of a line is interpolated
+            size_t num = ((end[dims[pass]] - begin[dims[pass]]) / stride + 1) / 2;
+            for (uint i = 0; i < N; i++) {
+                if (i == pass) {
+                    continue;
                 }
+                size_t step = i < pass ? stride : stride * 2;
+                size_t first = begin[dims[i]] ? begin[dims[i]] + step : 0;
+                num *= first > end[dims[i]] ? 0 : (end[dims[i]] - first) / step + 1;
             }
-            return predict_error;
+            return num;
         }
         
-        template<uint NN = N>
-        typename std::enable_if<NN == 4, double>::type
-        block_interpolation(T *data, std::array<size_t, N> begin, std::array<size_t, N> end, const PredictorBehavior pb,
-                            const std::string &interp_func, const int direction, size_t stride = 1) {
+        double block_interpolation(Lane &lane, T *data, const std::array<size_t, N> &begin, const std::array<size_t, N> &end,
+                                   const PredictorBehavior pb, const int direction, size_t stride = 1) {
             double predict_error = 0;
-            size_t stride2x = stride * 2;
-            max_error = 0;
-            const std::array<int, N> dims = dimension_sequences[direction];
-            for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride2x : 0); j <= end[dims[1]]; j += stride2x) {
-                for (size_t k = (begin[dims[2]] ? begin[dims[2]] + stride2x : 0); k <= end[dims[2]]; k += stride2x) {
-                    for (size_t t = (begin[dims[3]] ? begin[dims[3]] + stride2x : 0);
-                         t <= end[dims[3]]; t += stride2x) {
-                        size_t begin_offset =
-                            begin[dims[0]] * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]] +
-                                k * dimension_offsets[dims[2]] +
-                                t * dimension_offsets[dims[3]];
-                        predict_error += block_interpolation_1d(data, begin_offset,
-                                                                begin_offset +
-                                                                    (end[dims[0]] - begin[dims[0]]) *
-                                                                        dimension_offsets[dims[0]],
-                                                                stride * dimension_offsets[dims[0]], interp_func, pb);
+            for (uint pass = 0; pass < N; pass++) {
+                predict_error += block_interpolation_pass(lane, data, begin, end, pass, pb, direction, stride);
+            }
+            return predict_error;
+        }
+        
+        // whether interpolate_level runs on several threads, nested parallel regions run serially
+        bool run_parallel() const {
+#ifdef _OPENMP
+            return parallel && omp_get_max_threads() > 1 && !omp_in_parallel();
+#else
+            return false;
+#endif
+        }
+        
+        /**
+         * interpolate all points of the level of the given stride, in blocks of blocksize * stride along each dimension.
+         * With parallel on, the blocks are spread over the openmp threads one pass at a time (see block_interpolation_pass),
+         * every block taking its quantization indices and unpredictable values at the place they have in the serial order.
+         */
+        void interpolate_level(T *data, size_t stride, const PredictorBehavior pb) {
+            std::vector<std::array<size_t, N>> begins, ends;
+            auto inter_block_range = std::make_shared<
+                multi_dimensional_range<T, N>>(data, std::begin(global_dimensions), std::end(global_dimensions),
+                                               blocksize * stride, 0);
+            auto inter_begin = inter_block_range->begin();
+            auto inter_end = inter_block_range->end();
+            for (auto block = inter_begin; block != inter_end; ++block) {
+                auto end_idx = block.get_global_index();
+                for (int i = 0; i < N; i++) {
+                    end_idx[i] += blocksize * stride;
+                    if (end_idx[i] > global_dimensions[i] - 1) {
+                        end_idx[i] = global_dimensions[i] - 1;
                     }
                 }
+                begins.push_back(block.get_global_index());
+                ends.push_back(end_idx);
+            }
+            
+#ifdef _OPENMP
+            if (begins.size() > 1 && run_parallel()) {
+                interpolate_level_omp(data, begins, ends, stride, pb);
+                return;
             }
-            max_error = 0;
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                for (size_t k = (begin[dims[2]] ? begin[dims[2]] + stride2x : 0); k <= end[dims[2]]; k += stride2x) {
-                    for (size_t t = (begin[dims[3]] ? begin[dims[3]] + stride2x : 0);
-                         t <= end[dims[3]]; t += stride2x) {
-                        size_t begin_offset =
-                            i * dimension_offsets[dims[0]] + begin[dims[1]] * dimension_offsets[dims[1]] +
-                                k * dimension_offsets[dims[2]] +
-                                t * dimension_offsets[dims[3]];
-                        predict_error += block_interpolation_1d(data, begin_offset,
-                                                                begin_offset +
-                                                                    (end[dims[1]] - begin[dims[1]]) *
-                                                                        dimension_offsets[dims[1]],
-                                                                stride * dimension_offsets[dims[1]], interp_func, pb);
+#endif
+            Lane lane{quantizer, quant_index, pb == PB_recover ? nullptr : frequency.data(), {}};
+            for (size_t b = 0; b < begins.size(); b++) {
+                if (quant_stream) {
+                    size_t num = 0;
+                    for (uint pass = 0; pass < N; pass++) {
+                        num += block_interpolation_pass_size(begins[b], ends[b], pass, direction_sequence_id, stride);
                     }
+                    fetch_quant_inds(lane.quant_index, num);
                 }
+                block_interpolation(lane, data, begins[b], ends[b], pb, direction_sequence_id, stride);
             }
-            max_error = 0;
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride : 0); j <= end[dims[1]]; j += stride) {
-                    for (size_t t = (begin[dims[3]] ? begin[dims[3]] + stride2x : 0);
-                         t <= end[dims[3]]; t += stride2x) {
-                        size_t begin_offset = i * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]] +
-                            begin[dims[2]] * dimension_offsets[dims[2]] +
-                            t * dimension_offsets[dims[3]];
-                        predict_error += block_interpolation_1d(data, begin_offset,
-                                                                begin_offset +
-                                                                    (end[dims[2]] - begin[dims[2]]) *
-                                                                        dimension_offsets[dims[2]],
-                                                                stride * dimension_offsets[dims[2]], interp_func, pb);
-                    }
+            quant_index = lane.quant_index;
+        }
+
+#ifdef _OPENMP
+        
+        void interpolate_level_omp(T *data, const std::vector<std::array<size_t, N>> &begins,
+                                   const std::vector<std::array<size_t, N>> &ends, size_t stride, const PredictorBehavior pb) {
+            // task t = b * N + pass, in the serial order
+            size_t tasks = begins.size() * N;
+            std::vector<size_t> task_index(tasks + 1);
+            task_index[0] = quant_index;
+            for (size_t t = 0; t < tasks; t++) {
+                task_index[t + 1] = task_index[t] +
+                    block_interpolation_pass_size(begins[t / N], ends[t / N], t % N, direction_sequence_id, stride);
+            }
+            
+            // first unpredictable value of every task when decompressing, the quantization index 0 marks them
+            std::vector<size_t> task_unpred;
+            if (pb == PB_recover) {
+                fetch_quant_inds(quant_index, task_index[tasks] - quant_index);
+                task_unpred.resize(tasks + 1);
+                #pragma omp parallel for schedule(static)
+                for (size_t t = 0; t < tasks; t++) {
+                    task_unpred[t + 1] = std::count(quant_inds + (task_index[t] - quant_base),
+                                                    quant_inds + (task_index[t + 1] - quant_base), 0);
+                }
+                task_unpred[0] = quantizer.get_unpred_index();
+                for (size_t t = 0; t < tasks; t++) {
+                    task_unpred[t + 1] += task_unpred[t];
                 }
             }
             
-            max_error = 0;
-            for (size_t i = (begin[dims[0]] ? begin[dims[0]] + stride : 0); i <= end[dims[0]]; i += stride) {
-                for (size_t j = (begin[dims[1]] ? begin[dims[1]] + stride : 0); j <= end[dims[1]]; j += stride) {
-                    for (size_t k = (begin[dims[2]] ? begin[dims[2]] + stride : 0); k <= end[dims[2]]; k += stride) {
-                        size_t begin_offset =
-                            i * dimension_offsets[dims[0]] + j * dimension_offsets[dims[1]] +
-                                k * dimension_offsets[dims[2]] +
-                                begin[dims[3]] * dimension_offsets[dims[3]];
-                        predict_error += block_interpolation_1d(data, begin_offset,
-                                                                begin_offset +
-                                                                    (end[dims[3]] - begin[dims[3]]) *
-                                                                        dimension_offsets[dims[3]],
-                                                                stride * dimension_offsets[dims[3]], interp_func, pb);
+            // unpredictable values of every task when compressing, joined in the serial order at the end
+            std::vector<Quantizer> task_quantizers(pb == PB_recover ? 0 : tasks, quantizer.fork());
+            // quantization indices counted by every thread, added up at the end of compress
+            if (pb != PB_recover && thread_frequency.size() < (size_t) omp_get_max_threads()) {
+                thread_frequency.resize(omp_get_max_threads(), std::vector<size_t>(frequency.size(), 0));
+            }
+            for (uint pass = 0; pass < N; pass++) {
+                #pragma omp parallel for schedule(dynamic)
+                for (size_t b = 0; b < begins.size(); b++) {
+                    size_t t = b * N + pass;
+                    if (pb == PB_recover) {
+                        Quantizer task_quantizer = quantizer.fork();
+                        task_quantizer.append_unpred(quantizer, task_unpred[t], task_unpred[t + 1]);
+                        Lane lane{task_quantizer, task_index[t], nullptr, {}};
+                        block_interpolation_pass(lane, data, begins[b], ends[b], pass, pb, direction_sequence_id, stride);
+                    } else {
+                        Lane lane{task_quantizers[t], task_index[t], thread_frequency[omp_get_thread_num()].data(), {}};
+                        block_interpolation_pass(lane, data, begins[b], ends[b], pass, pb, direction_sequence_id, stride);
                     }
                 }
             }
-            return predict_error;
+            
+            if (pb == PB_recover) {
+                quantizer.set_unpred_index(task_unpred[tasks]);
+            } else {
+                for (auto &q: task_quantizers) {
+                    quantizer.append_unpred(q, 0, q.get_unpred_num());
+                }
+            }
+            quant_index = task_index[tasks];
         }
+
+#endif
         
         int interpolation_level = -1;
         uint blocksize;
         int interpolator_id;
         double eb_ratio = 0.5;
-        std::vector<std::string> interpolators = {"linear", "cubic"};
         int *quant_inds;
         size_t quant_index = 0;
-        double max_error;
+        SymbolStream<int> *quant_stream = nullptr; // source of the quantization indices in decompress_stream
+        std::vector<int> quant_window; // indices fetched from quant_stream
+        size_t quant_base = 0; // index of quant_inds[0]
+        const T *ori_data = nullptr; // original values when data only holds a slab of the reconstructed values
+        size_t data_offset = 0; // global offset of the first value in data
+        std::vector<size_t> strides; // layout of the data, empty if contiguous
         Quantizer quantizer;
+        bool progressive = false;
+        bool parallel = false; // interpolate every level on all openmp threads, see interpolate_level
+        std::vector<size_t> frequency; // see get_frequency
+        std::vector<std::vector<size_t>> thread_frequency; // counts of the openmp threads, see interpolate_level_omp
+        std::vector<Quantizer> level_quantizers; // quantizer of every level, coarsest first, when progressive is on
         size_t num_elements;
         std::array<size_t, N> global_dimensions;
         std::array<size_t, N> dimension_offsets;
@@ -44,6 +44,11 @@ namespace SZ3 {
 
 
         std::vector<int> compress(const Config &conf, T *data) {
+            return compress(conf, (const T *) data);
+        };
+
+        // the reconstructed values are kept in a padded plane buffer, data is not modified
+        std::vector<int> compress(const Config &conf, const T *data) {
             if (N == 1) {
                 return compress_1d(data);
             } else {
@@ -52,13 +57,33 @@ namespace SZ3 {
         };
 
         T *decompress(const Config &conf, std::vector<int> &quant_inds, T *dec_data) {
+            const int *pos = quant_inds.data();
+            auto fetch = [&](size_t n) {
+                pos += n;
+                return pos - n;
+            };
             if (N == 1) {
-                return decompress_1d(quant_inds, dec_data);
+                return decompress_1d(fetch, dec_data);
             } else {
-                return decompress_3d(quant_inds, dec_data);
+                return decompress_3d(fetch, dec_data);
             }
         };
 
+        // the quantization indices are decoded one block at a time
+        T *decompress_stream(const Config &conf, SymbolStream<int> &quant_inds, T *dec_data) {
+            std::vector<int> block;
+            auto fetch = [&](size_t n) {
+                block.resize(n);
+                quant_inds.next(block.data(), n);
+                return (const int *) block.data();
+            };
+            if (N == 1) {
+                return decompress_1d(fetch, dec_data);
+            } else {
+                return decompress_3d(fetch, dec_data);
+            }
+        }
+
 
         void save(uchar *&c) {
             if (N == 3) {
@@ -100,7 +125,6 @@ namespace SZ3 {
 
         void load(const uchar *&c, size_t &remaining_length) {
             clear();
-            const uchar *c_pos = c;
             if (N == 3) {
 
                 read(params, c, remaining_length);
@@ -119,17 +143,18 @@ namespace SZ3 {
 
                 indicator_huffman = HuffmanEncoder<int>();
                 indicator_huffman.load(c, remaining_length);
+                const uchar *indicator_pos = c;
                 indicator = indicator_huffman.decode(c, size.num_blocks);
                 indicator_huffman.postprocess_decode();
+                remaining_length -= c - indicator_pos;
 
 
                 if (reg_count) {
-                    reg_params = decode_regression_coefficients(c, reg_count, size.block_size, precision,
-                                                                params);
+                    reg_params = decode_regression_coefficients(c, remaining_length, reg_count, size.block_size,
+                                                                precision, params);
                 }
             }
             quantizer.load(c, remaining_length);
-            remaining_length -= c_pos - c;
 
         }
 
@@ -166,25 +191,47 @@ namespace SZ3 {
                    + (reg_unpredictable_data_pos - reg_unpredictable_data) * sizeof(float); //reg coeff unpred
         }
 
+        // worst-case size of save(), the unpredictable values are bounded together with the quantization indices
+        size_t size_bound(const Config &conf) {
+            size_t bound = quantizer.size_bound(0);
+            if (N == 3) {
+                size_t num_blocks = SZMETA::DSize_3d(conf.dims[0], conf.dims[1], conf.dims[2], conf.blockSize).num_blocks;
+                bound += sizeof(params) + sizeof(precision) + sizeof(mean_info.use_mean) + sizeof(mean_info.mean) + sizeof(reg_count)
+                         + HuffmanEncoder<int>().size_bound(num_blocks, SELECTOR_RADIUS)
+                         // regression coefficients, unpredictable ones are stored as float
+                         + sizeof(size_t) + HuffmanEncoder<int>().size_bound(RegCoeffNum3d * num_blocks, RegCoeffRadius * 2, 8 * sizeof(float));
+            }
+            return bound;
+        }
+
         int get_radius() {
 //            return capacity;
             return quantizer.get_radius();
         }
 
     private:
-        std::vector<int> compress_1d(T *data) {
+        std::vector<int> compress_1d(const T *data) {
             std::vector<int> quant_bins(conf.num);
-            quant_bins[0] = quantizer.quantize_and_overwrite(data[0], 0);
+            T pred = 0;
+            quant_bins[0] = quantizer.quantize_and_overwrite(data[0], 0, pred);
             for (size_t i = 1; i < conf.num; i++) {
-                quant_bins[i] = quantizer.quantize_and_overwrite(data[i], data[i - 1]);
+                quant_bins[i] = quantizer.quantize_and_overwrite(data[i], pred, pred);
             }
             return quant_bins;
         }
 
-        T *decompress_1d(std::vector<int> &quant_inds, T *dec_data) {
-            dec_data[0] = quantizer.recover(0, quant_inds[0]);
-            for (size_t i = 1; i < conf.num; i++) {
-                dec_data[i] = quantizer.recover(dec_data[i - 1], quant_inds[i]);
+        /**
+         * @param fetch returns the next n quantization indices, valid until the next call
+         */
+        template<class Fetch>
+        T *decompress_1d(Fetch &&fetch, T *dec_data) {
+            T pred = 0;
+            for (size_t i = 0; i < conf.num; i += block_1d) {
+                size_t n = std::min<size_t>(block_1d, conf.num - i);
+                const int *quant_inds = fetch(n);
+                for (size_t j = 0; j < n; j++) {
+                    dec_data[i + j] = pred = quantizer.recover(pred, quant_inds[j]);
+                }
             }
             return dec_data;
         }
@@ -404,15 +451,15 @@ namespace SZ3 {
 
         //T *
 //        meta_decompress_3d(const unsigned char *compressed, size_t r1, size_t r2, size_t r3) {
-        T *decompress_3d(std::vector<int> &quant_inds, T *dec_data) {
+        template<class Fetch>
+        T *decompress_3d(Fetch &&fetch, T *dec_data) {
 
 
-            int *type = quant_inds.data();
 //            T *dec_data = new T[size.num_elements];
 //    dec_data_sp_float = (float *) dec_data;
             const float *reg_params_pos = (const float *) (reg_params + RegCoeffNum3d);;
 
-            const int *type_pos = type;
+            const int *type_pos;
             const int *indicator_pos = indicator.data();
 //        const float *reg_params_pos = reg_params;
             // add one more ghost layer
@@ -438,6 +485,7 @@ namespace SZ3 {
                                                                                                j * size.block_size;
                         int size_z = ((k + 1) * size.block_size < size.d3) ? size.block_size : size.d3 -
                                                                                                k * size.block_size;
+                        type_pos = fetch((size_t) size_x * size_y * size_z);
                         if (*indicator_pos == SELECTOR_REGRESSION) {
                             // regression
                             regression_predict_recover_3d<T>(reg_params_pos, pred_buffer_pos, precision,
@@ -610,6 +658,7 @@ namespace SZ3 {
 
         Quantizer quantizer;
         Config conf;
+        static constexpr size_t block_1d = 4096; // quantization indices fetched at once by decompress_1d
 
     };
 
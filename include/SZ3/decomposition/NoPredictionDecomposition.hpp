@@ -26,9 +26,15 @@ namespace SZ3 {
         }
 
         std::vector<int> compress(const Config &conf, T *data) {
+            return compress(conf, (const T *) data);
+        }
+
+        // no value is predicted from reconstructed ones, so data is not modified
+        std::vector<int> compress(const Config &conf, const T *data) {
             std::vector<int> quant_inds(conf.num);
+            T dec;
             for (size_t i = 0; i < conf.num; i++) {
-                quant_inds[i] = quantizer.quantize_and_overwrite(data[i], 0);
+                quant_inds[i] = quantizer.quantize_and_overwrite(data[i], 0, dec);
             }
             quantizer.postcompress_data();
             return quant_inds;
@@ -42,6 +48,13 @@ namespace SZ3 {
             quantizer.load(c, remaining_length);
         }
 
+        // worst-case size of save(), the unpredictable values are bounded together with the quantization indices
+        size_t size_bound(const Config &conf) {
+            return quantizer.size_bound(0);
+        }
+
+        int get_radius() { return quantizer.get_radius(); }
+
     private:
         Quantizer quantizer;
     };
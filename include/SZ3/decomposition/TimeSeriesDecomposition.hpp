@@ -184,6 +184,15 @@ namespace SZ3 {
             quantizer.load(c, remaining_length);
         }
 
+        // worst-case size of save(), the unpredictable values are bounded together with the quantization indices
+        size_t size_bound(const Config &conf) {
+            size_t num_blocks = 1;
+            for (uint i = 1; i < N; i++) {
+                num_blocks *= (conf.dims[i] - 1) / block_size + 1;
+            }
+            return N * sizeof(size_t) + sizeof(block_size) + predictor.size_bound(num_blocks) + quantizer.size_bound(0);
+        }
+
         int get_radius() const { return quantizer.get_radius(); }
 
     private:
@@ -2,12 +2,23 @@
 #define _DEF_HPP
 
 #include <cmath>
+#include <stdexcept>
 
 namespace SZ3 {
 
     typedef unsigned int uint;
     typedef unsigned char uchar;
 
+    /**
+     * the compressed data does not fit the capacity of its output buffer (cmpCap, dstCap).
+     * Only this error makes the compression fall back to a layout that needs less room,
+     * a std::length_error of any other origin is passed on.
+     */
+    class CapacityError : public std::length_error {
+    public:
+        using std::length_error::length_error;
+    };
+
 }
 
 
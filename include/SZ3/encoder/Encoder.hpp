@@ -1,9 +1,76 @@
 #ifndef _SZ_ENCODER_HPP
 #define _SZ_ENCODER_HPP
 
+#include "SZ3/def.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 namespace SZ3 {
+
+    /**
+     * symbols of an encoded stream decoded on demand, in their order, instead of all at once into a vector.
+     * Users read a few at a time (a block of data), so the decoded symbols stay in cache
+     * and the whole output of decode() is never kept in memory. See EncoderInterface::decode_stream.
+     */
+    template<class T>
+    class SymbolStream {
+    public:
+        virtual ~SymbolStream() = default;
+
+        // next symbol
+        T next() {
+            if (pos == buffered) {
+                buffered = std::min(buffer_size, remaining);
+                remaining -= buffered;
+                decode(buffer, buffered);
+                pos = 0;
+            }
+            return buffer[pos++];
+        }
+
+        // next n symbols, written to out
+        void next(T *out, size_t n) {
+            size_t m = std::min(n, buffered - pos);
+            std::copy_n(buffer + pos, m, out);
+            pos += m;
+            if (m < n) {
+                remaining -= n - m;
+                decode(out + m, n - m);
+            }
+        }
+
+    protected:
+        // @param length number of symbols in the stream
+        explicit SymbolStream(size_t length) : remaining(length) {}
+
+        // decode the next n symbols to out
+        virtual void decode(T *out, size_t n) = 0;
+
+    private:
+        static constexpr size_t buffer_size = 256;
+        T buffer[buffer_size];
+        size_t pos = 0, buffered = 0, remaining;
+    };
+
+    // stream of symbols already decoded, for encoders without a decoder of their own
+    template<class T>
+    class VectorSymbolStream : public SymbolStream<T> {
+    public:
+        explicit VectorSymbolStream(std::vector<T> symbols) : SymbolStream<T>(symbols.size()), symbols(std::move(symbols)) {}
+
+    protected:
+        void decode(T *out, size_t n) {
+            std::copy_n(symbols.begin() + decoded, n, out);
+            decoded += n;
+        }
+
+    private:
+        std::vector<T> symbols;
+        size_t decoded = 0;
+    };
+
     namespace concepts {
 
         /**
@@ -26,6 +93,14 @@ namespace SZ3 {
              */
             virtual void preprocess_encode(const std::vector<T> &bins, int stateNum) = 0;
 
+            /**
+             * same as preprocess_encode(bins, frequency.size()),
+             * with the number of occurrences of each value of bins in [0, frequency.size()) already counted by the caller
+             */
+            virtual void preprocess_encode_counted(const std::vector<T> &bins, const std::vector<size_t> &frequency) {
+                preprocess_encode(bins, frequency.size());
+            }
+
             /**
              * encode the input (in vector<T> format) to a more compact representative(in byte stream format)
              * @param bins input in vector
@@ -43,6 +118,15 @@ namespace SZ3 {
              */
             virtual std::vector<T> decode(const uchar *&bytes, size_t targetLength) = 0;
 
+            /**
+             * same as decode(), with the symbols decoded on demand
+             * @param bytes input in byte stream, moved past the encoded symbols right away.
+             *        The returned stream reads it, it must be kept until the stream is no longer used (so must the encoder).
+             */
+            virtual std::unique_ptr<SymbolStream<T>> decode_stream(const uchar *&bytes, size_t targetLength) {
+                return std::unique_ptr<SymbolStream<T>>(new VectorSymbolStream<T>(decode(bytes, targetLength)));
+            }
+
             /**
              * serialize the encoder and store it to a buffer
              * @param c One large buffer is pre-allocated, and the start location of the serialized encoder in the buffer is indicated by c.
@@ -7,22 +7,57 @@
 #include "SZ3/utils/MemoryUtil.hpp"
 #include "SZ3/utils/Timer.hpp"
 #include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #if INTPTR_MAX == INT64_MAX // 64bit system
     #include "SZ3/utils/ska_hash/unordered_map.hpp"
 #endif // INTPTR_MAX == INT64_MAX
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <set>
 
 
 namespace SZ3 {
 
+    /**
+     * whether the HuffmanEncoders of this thread load trees in the format of data version 3.2.0
+     * (node arrays, followed by the codes in one piece; see SZ3_LEGACY_DATA_VER).
+     * The predictors and decompositions create their encoders as they load, out of reach of the Config of the data,
+     * so the format is set for the thread during a decompression (see LegacyHuffmanFormat).
+     */
+    inline bool &huffman_legacy_format() {
+        static thread_local bool legacy = false;
+        return legacy;
+    }
+
+    // sets huffman_legacy_format() for the lifetime of the object
+    class LegacyHuffmanFormat {
+    public:
+        explicit LegacyHuffmanFormat(bool legacy) : previous(huffman_legacy_format()) {
+            huffman_legacy_format() = legacy;
+        }
+
+        ~LegacyHuffmanFormat() { huffman_legacy_format() = previous; }
+
+        LegacyHuffmanFormat(const LegacyHuffmanFormat &) = delete;
+
+        LegacyHuffmanFormat &operator=(const LegacyHuffmanFormat &) = delete;
+
+    private:
+        bool previous;
+    };
 
     template<class T>
     class HuffmanEncoder : public concepts::EncoderInterface<T> {
@@ -38,17 +73,25 @@ namespace SZ3 {
 
         typedef struct HuffmanTree {
             unsigned int stateNum;
-            unsigned int allNodes;
             struct node_t *pool;
             node *qqq, *qq; //the root node of the HuffmanTree is qq[1]
             int n_nodes; //n_nodes is for compression
             int qend;
-            uint64_t **code;
-            unsigned char *cout;
-            int n_inode; //n_inode is for decompression
+            uint64_t *code; //code of state i, from the most significant bit
+            unsigned char *cout; //length of the code of state i, 0 if state i has no code
+            unsigned int *used; //the states with a code, in increasing order once the codes are assigned
+            unsigned int n_used;
             int maxBitCount;
+            unsigned int stateCapacity; //largest stateNum the buffers can hold
+            size_t nodeCapacity; //number of nodes the buffers can hold
         } HuffmanTree;
 
+#if INTPTR_MAX == INT64_MAX // 64bit system
+        typedef ska::unordered_map<T, size_t> FrequencyMap;
+#else // most likely 32bit system
+        typedef std::unordered_map<T, size_t> FrequencyMap;
+#endif // INTPTR_MAX == INT64_MAX
+
 
         HuffmanEncoder() {
             int x = 1;
@@ -63,30 +106,53 @@ namespace SZ3 {
             SZ_FreeHuffman();
         }
 
-        //build huffman tree
-        HuffmanTree *createHuffmanTree(int stateNum) {
-            HuffmanTree *huffmanTree = (HuffmanTree *) malloc(sizeof(HuffmanTree));
-            memset(huffmanTree, 0, sizeof(HuffmanTree));
+        /**
+         * build huffman tree
+         * The tree memory is kept in a pool shared by the copies of this encoder, and reused by the next tree
+         * as long as it is large enough. A pool serves one tree at a time.
+         * Nodes are allocated for the symbols in use, and only the code lengths of the states used by the last tree
+         * are cleared, so that a tree of k symbols costs O(k) however wide the range of states.
+         * @param stateNum the states are in [0, stateNum)
+         * @param nodeNum number of nodes of the tree
+         */
+        HuffmanTree *createHuffmanTree(int stateNum, size_t nodeNum) {
+            if (!treePool) {
+                treePool = std::shared_ptr<HuffmanTree>((HuffmanTree *) calloc(1, sizeof(HuffmanTree)), free_tree_pool);
+            }
+            HuffmanTree *huffmanTree = treePool.get();
+            if (huffmanTree->stateCapacity < (unsigned int) stateNum) {
+                free(huffmanTree->code);
+                free(huffmanTree->cout);
+                free(huffmanTree->used);
+                huffmanTree->code = (uint64_t *) malloc(stateNum * sizeof(uint64_t));
+                huffmanTree->cout = (unsigned char *) calloc(stateNum, sizeof(unsigned char));
+                huffmanTree->used = (unsigned int *) malloc(stateNum * sizeof(unsigned int));
+                huffmanTree->stateCapacity = stateNum;
+            } else {
+                for (unsigned int i = 0; i < huffmanTree->n_used; i++) {
+                    huffmanTree->cout[huffmanTree->used[i]] = 0;
+                }
+            }
+            huffmanTree->n_used = 0;
             huffmanTree->stateNum = stateNum;
-            huffmanTree->allNodes = 2 * stateNum;
-
-            huffmanTree->pool = (struct node_t *) malloc(huffmanTree->allNodes * 2 * sizeof(struct node_t));
-            huffmanTree->qqq = (node *) malloc(huffmanTree->allNodes * 2 * sizeof(node));
-            huffmanTree->code = (uint64_t **) malloc(huffmanTree->stateNum * sizeof(uint64_t *));
-            huffmanTree->cout = (unsigned char *) malloc(huffmanTree->stateNum * sizeof(unsigned char));
-
-            memset(huffmanTree->pool, 0, huffmanTree->allNodes * 2 * sizeof(struct node_t));
-            memset(huffmanTree->qqq, 0, huffmanTree->allNodes * 2 * sizeof(node));
-            memset(huffmanTree->code, 0, huffmanTree->stateNum * sizeof(uint64_t *));
-            memset(huffmanTree->cout, 0, huffmanTree->stateNum * sizeof(unsigned char));
-            huffmanTree->qq = huffmanTree->qqq - 1;
             huffmanTree->n_nodes = 0;
-            huffmanTree->n_inode = 0;
             huffmanTree->qend = 1;
-
+            reserve_nodes(huffmanTree, nodeNum);
             return huffmanTree;
         }
 
+        // room for nodeNum nodes, before the first node of the tree is created
+        static void reserve_nodes(HuffmanTree *huffmanTree, size_t nodeNum) {
+            if (huffmanTree->nodeCapacity < nodeNum) {
+                free(huffmanTree->pool);
+                free(huffmanTree->qqq);
+                huffmanTree->pool = (struct node_t *) malloc(nodeNum * sizeof(struct node_t));
+                huffmanTree->qqq = (node *) malloc(nodeNum * sizeof(node));
+                huffmanTree->nodeCapacity = nodeNum;
+            }
+            huffmanTree->qq = huffmanTree->qqq - 1;
+        }
+
         /**
          * build huffman tree using bins
          * @param bins
@@ -108,35 +174,126 @@ namespace SZ3 {
                 printf("Huffman bins should not be empty\n");
                 exit(0);
             }
+            if (sharedFrequency) {
+                for (size_t i = 0; i < num_bin; i++) {
+                    (*sharedFrequency)[bins[i]]++;
+                }
+            }
+            if (sharedTree) {
+                useSharedTree = sharedTree->covers(bins, num_bin);
+                if (useSharedTree) {
+                    return;
+                }
+            }
             init(bins, num_bin);
-            for (int i = 0; i < huffmanTree->stateNum; i++)
-                if (huffmanTree->code[i]) nodeCount++;
-            nodeCount = nodeCount * 2 - 1;
+            choose_runs(bins, num_bin);
         }
 
-        //save the huffman Tree in the compressed data
+        /**
+         * build huffman tree from the number of occurrences of each value of bins in [0, frequency.size()),
+         * counted by the caller (e.g., by the decomposition while quantizing) instead of hashing every bin here
+         * @param bins
+         * @param frequency
+         */
+        void preprocess_encode_counted(const std::vector<T> &bins, const std::vector<size_t> &frequency) {
+            nodeCount = 0;
+            if (bins.empty()) {
+                printf("Huffman bins should not be empty\n");
+                exit(0);
+            }
+            std::vector<std::pair<T, size_t>> used;
+            for (size_t i = 0; i < frequency.size(); i++) {
+                if (frequency[i]) {
+                    used.emplace_back((T) i, frequency[i]);
+                }
+            }
+            if (sharedFrequency) {
+                for (const auto &f: used) {
+                    (*sharedFrequency)[f.first] += f.second;
+                }
+            }
+            if (sharedTree) {
+                useSharedTree = sharedTree->covers(used);
+                if (useSharedTree) {
+                    return;
+                }
+            }
+            build_tree(used);
+            choose_runs(bins.data(), bins.size());
+        }
+
+        /**
+         * save the Huffman tree in the compressed data: the codes are canonical, so only their lengths are stored
+         * (see serialize_lengths). Trees saved as node arrays by data version 3.2.0 are still loaded (see huffman_legacy_format).
+         * In run-length mode, the dominant symbol, -1 in place of the node count, the first run token
+         * and the tree of the tokens.
+         */
         void save(uchar *&c) {
-            auto cc = c;
+            if (sharedTree) {
+                write((uchar) useSharedTree, c);
+                if (useSharedTree) {
+                    return;
+                }
+            }
+            if (runTokens) {
+                write(dominant, c);
+                int32ToBytes_bigEndian(c, -1);
+                c += sizeof(int);
+                write(runBase, c);
+                runTokens->save(c);
+                return;
+            }
             write(offset, c);
-            int32ToBytes_bigEndian(c, nodeCount);
+            int32ToBytes_bigEndian(c, 0); // no node arrays: code lengths follow
             c += sizeof(int);
-            int32ToBytes_bigEndian(c, huffmanTree->stateNum / 2);
+            int32ToBytes_bigEndian(c, huffmanTree->stateNum - 1);
             c += sizeof(int);
-            uint totalSize = 0;// = convert_HuffTree_to_bytes_anyStates(nodeCount, c);
-            // std::cout << "nodeCount = " << nodeCount << std::endl;
-            if (nodeCount <= 256)
-                totalSize = convert_HuffTree_to_bytes_anyStates<unsigned char>(nodeCount, c);
-            else if (nodeCount <= 65536)
-                totalSize = convert_HuffTree_to_bytes_anyStates<unsigned short>(nodeCount, c);
-            else
-                totalSize = convert_HuffTree_to_bytes_anyStates<unsigned int>(nodeCount, c);
-            c += totalSize;
-//            return c - cc;
+            memcpy(c, codeLengths.data(), codeLengths.size());
+            c += codeLengths.size();
+        }
+
+        /**
+         * worst-case size of save() + encode(), known before the tree is built
+         * @param num number of symbols to be encoded
+         * @param stateNum stateNum > 0 indicates the symbols are in [0, stateNum). stateNum == 0 means no such guarantee
+         * @param rawBits bits stored outside the encoder for every occurrence of symbol 0
+         *        (e.g., unpredictable values kept by the quantizer), they are included in the bound
+         * @return size in bytes, including the slack needed by the 64-bit stores in encode()
+         *         and, with a shared tree, the codes of that tree
+         */
+        size_t size_bound(size_t num, int stateNum, size_t rawBits = 0) const {
+            size_t symbols = std::max<size_t>(1, stateNum > 0 ? std::min<size_t>(num, stateNum) : num);
+            // one byte per state at most, and 6 bytes per symbol (its length and the zeros before it)
+            size_t lengthsSize = stateNum > 0 ? std::min<size_t>(stateNum, 6 * symbols) : 6 * symbols;
+            size_t treeSize = sizeof(T) + sizeof(int) + sizeof(int) + lengthsSize;
+
+            size_t codeBits = 0;
+            while ((size_t(1) << codeBits) < symbols) {
+                codeBits++;
+            }
+            // Huffman codes are never longer in total than a fixed-length code (codeBits per symbol),
+            // or than a code spending 1 bit on symbol 0 and codeBits + 1 bits on the others.
+            // Maximizing over the count of symbol 0 gives the two candidates below.
+            size_t bits = num * (rawBits + 1);
+            if (codeBits > 0) {
+                bits = std::max(bits, num * codeBits + num * rawBits / codeBits + 1);
+            }
+            // segment table, and the last byte of every segment
+            size_t segments = std::max<size_t>(1, (num + segment_size - 1) / segment_size);
+            size_t segmentsSize = 1 + (segments - 1) * sizeof(uint32_t) + segments;
+            size_t bound = treeSize + sizeof(size_t) + segmentsSize + bits / 8 + 2 * sizeof(uint64_t);
+            if (sharedTree) {
+                size_t sharedBits = num * (sharedTree->maxCodeLength + rawBits);
+                bound = 1 + std::max(bound, sizeof(size_t) + segmentsSize + sharedBits / 8 + 2 * sizeof(uint64_t));
+            }
+            return bound;
         }
 
         size_t size_est() {
-            size_t b = (nodeCount <= 256) ? sizeof(unsigned char) : ((nodeCount <= 65536) ? sizeof(unsigned short) : sizeof(unsigned int));
-            return 1 + 2 * nodeCount * b + nodeCount * sizeof(unsigned char) + nodeCount * sizeof(T) + sizeof(int) + sizeof(int) + sizeof(T);
+            if (runTokens) {
+                return 1 + sizeof(T) + sizeof(int) + sizeof(T) + runTokens->size_est();
+            }
+            return 1 + sizeof(T) + sizeof(int) + sizeof(int) + codeLengths.size();
         }
 
         //perform encoding
@@ -144,88 +301,79 @@ namespace SZ3 {
             return encode(bins.data(), bins.size(), bytes);
         }
 
-        //perform encoding
+        /**
+         * perform encoding
+         * The bins are encoded in segments of segment_size bins, each starting on a byte, in parallel with OpenMP
+         * (unless called from a parallel region). The segments follow log2(segment_size) in one byte and the size in bytes
+         * of every segment but the last, so that they are decoded in parallel as well.
+         */
         size_t encode(const T *bins, size_t num_bin, uchar *&bytes) {
-            size_t outSize = 0;
-            size_t i = 0;
-            unsigned char bitSize = 0, byteSize, byteSizep;
-            int state;
+            if (useSharedTree) {
+                return sharedTree->encode(bins, num_bin, bytes);
+            }
+            if (runTokens) {
+                // the tokens of the bins passed to preprocess_encode
+                uchar *bytes0 = bytes;
+                write(tokens.size(), bytes);
+                runTokens->encode(tokens.data(), tokens.size(), bytes);
+                write(runBits.size(), bytes);
+                write(runBits.data(), runBits.size(), bytes);
+                return bytes - bytes0;
+            }
             uchar *p = bytes + sizeof(size_t);
-            int lackBits = 0;
-            //int64_t totalBitSize = 0, maxBitSize = 0, bitSize21 = 0, bitSize32 = 0;
-            for (i = 0; i < num_bin; i++) {
-                state = bins[i] - offset;
-                bitSize = huffmanTree->cout[state];
-
-                if (lackBits == 0) {
-                    byteSize = bitSize % 8 == 0 ? bitSize / 8 : bitSize / 8 +
-                                                                1; //it's equal to the number of bytes involved (for *outSize)
-                    byteSizep = bitSize / 8; //it's used to move the pointer p for next data
-                    if (byteSize <= 8) {
-                        int64ToBytes_bigEndian(p, (huffmanTree->code[state])[0]);
-                        p += byteSizep;
-                    } else //byteSize>8
-                    {
-                        int64ToBytes_bigEndian(p, (huffmanTree->code[state])[0]);
-                        p += 8;
-                        int64ToBytes_bigEndian(p, (huffmanTree->code[state])[1]);
-                        p += (byteSizep - 8);
+            size_t segments = std::max<size_t>(1, (num_bin + segment_size - 1) / segment_size);
+            *p++ = segment_bits;
+            uchar *table = p;
+            p += (segments - 1) * sizeof(uint32_t);
+            std::vector<size_t> segmentBytes(segments);
+            if (parallel_segments(segments)) {
+                std::vector<size_t> segmentOffset(segments + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+                for (size_t s = 0; s < segments; s++) {
+                    size_t bits = 0;
+                    for (size_t i = s * segment_size; i < std::min(num_bin, (s + 1) * segment_size); i++) {
+                        bits += huffmanTree->cout[bins[i] - offset];
                     }
-                    outSize += byteSize;
-                    lackBits = bitSize % 8 == 0 ? 0 : 8 - bitSize % 8;
-                } else {
-                    *p = (*p) | (unsigned char) ((huffmanTree->code[state])[0] >> (64 - lackBits));
-                    if (lackBits < bitSize) {
-                        p++;
-
-                        int64_t newCode = (huffmanTree->code[state])[0] << lackBits;
-                        int64ToBytes_bigEndian(p, newCode);
-
-                        if (bitSize <= 64) {
-                            bitSize -= lackBits;
-                            byteSize = bitSize % 8 == 0 ? bitSize / 8 : bitSize / 8 + 1;
-                            byteSizep = bitSize / 8;
-                            p += byteSizep;
-                            outSize += byteSize;
-                            lackBits = bitSize % 8 == 0 ? 0 : 8 - bitSize % 8;
-                        } else //bitSize > 64
-                        {
-                            byteSizep = 7; //must be 7 bytes, because lackBits!=0
-                            p += byteSizep;
-                            outSize += byteSize;
-
-                            bitSize -= 64;
-                            if (lackBits < bitSize) {
-                                *p = (*p) | (unsigned char) ((huffmanTree->code[state])[0] >> (64 - lackBits));
-                                p++;
-                                newCode = (huffmanTree->code[state])[1] << lackBits;
-                                int64ToBytes_bigEndian(p, newCode);
-                                bitSize -= lackBits;
-                                byteSize = bitSize % 8 == 0 ? bitSize / 8 : bitSize / 8 + 1;
-                                byteSizep = bitSize / 8;
-                                p += byteSizep;
-                                outSize += byteSize;
-                                lackBits = bitSize % 8 == 0 ? 0 : 8 - bitSize % 8;
-                            } else //lackBits >= bitSize
-                            {
-                                *p = (*p) | (unsigned char) ((huffmanTree->code[state])[0] >> (64 - bitSize));
-                                lackBits -= bitSize;
-                            }
-                        }
-                    } else //lackBits >= bitSize
-                    {
-                        lackBits -= bitSize;
-                        if (lackBits == 0)
-                            p++;
+                    segmentBytes[s] = (bits + 7) / 8;
+                }
+                for (size_t s = 0; s < segments; s++) {
+                    segmentOffset[s + 1] = segmentOffset[s] + segmentBytes[s];
+                }
+#pragma omp parallel
+                {
+                    // encode_segment writes up to 8 bytes past the end of the segment, which belong to the next one
+                    std::vector<uchar> buffer(segment_size * max_code_length / 8 + 2 * sizeof(uint64_t));
+#pragma omp for schedule(dynamic)
+                    for (size_t s = 0; s < segments; s++) {
+                        uchar *q = buffer.data();
+                        size_t begin = s * segment_size;
+                        encode_segment(bins + begin, std::min(num_bin, begin + segment_size) - begin, q);
+                        memcpy(p + segmentOffset[s], buffer.data(), segmentBytes[s]);
                     }
                 }
+                p += segmentOffset[segments];
+            } else {
+                for (size_t s = 0; s < segments; s++) {
+                    uchar *q = p;
+                    size_t begin = s * segment_size;
+                    encode_segment(bins + begin, std::min(num_bin, begin + segment_size) - begin, p);
+                    segmentBytes[s] = p - q;
+                }
             }
+            for (size_t s = 0; s + 1 < segments; s++) {
+                int32ToBytes_bigEndian(table + s * sizeof(uint32_t), segmentBytes[s]);
+            }
+            size_t outSize = p - (bytes + sizeof(size_t));
             *reinterpret_cast<size_t *>(bytes) = outSize;
             bytes += sizeof(size_t) + outSize;
             return outSize;
         }
 
         void postprocess_encode() {
+            useSharedTree = false;
+            runTokens.reset();
+            tokens.clear();
+            runBits.clear();
             SZ_FreeHuffman();
         }
 
@@ -233,47 +381,110 @@ namespace SZ3 {
 
         //perform decoding
         std::vector<T> decode(const uchar *&bytes, size_t targetLength) {
-            node t = treeRoot;
             std::vector<T> out(targetLength);
-            size_t i = 0, byteIndex = 0, count = 0;
-            int r;
-            node n = treeRoot;
+            decode_stream(bytes, targetLength)->next(out.data(), targetLength);
+            return out;
+        }
+
+        /**
+         * decode the symbols on demand, see SymbolStream
+         * The stream uses the tree of this encoder: it must be read before postprocess_decode() or the next load().
+         */
+        std::unique_ptr<SymbolStream<T>> decode_stream(const uchar *&bytes, size_t targetLength) {
+            if (useSharedTree) {
+                return sharedTree->decode_stream(bytes, targetLength);
+            }
+            if (runTokens) {
+                size_t tokenCount, runBytes;
+                read(tokenCount, bytes);
+                auto tokenStream = runTokens->decode_stream(bytes, tokenCount);
+                read(runBytes, bytes);
+                const uchar *bits = bytes;
+                bytes += runBytes;
+                return std::unique_ptr<SymbolStream<T>>(
+                        new RunLengthSymbolStream(std::move(tokenStream), bits, bits + runBytes, dominant, runBase, targetLength));
+            }
             size_t encodedLength = *reinterpret_cast<const size_t *>(bytes);
             bytes += sizeof(size_t);
-            if (n->t) //root->t==1 means that all state values are the same (constant)
-            {
-                for (count = 0; count < targetLength; count++)
-                    out[count] = n->c + offset;
-                return out;
+            const uchar *end = bytes + encodedLength;
+            std::vector<Segment> segments;
+            if (!segmented) {
+                segments.push_back({bytes, end, targetLength});
+            } else {
+                size_t segmentSize = size_t(1) << *bytes;
+                size_t num = std::max<size_t>(1, (targetLength + segmentSize - 1) / segmentSize);
+                const uchar *table = bytes + 1;
+                const uchar *p = table + (num - 1) * sizeof(uint32_t);
+                for (size_t s = 0; s < num; s++) {
+                    const uchar *q = s + 1 < num ? p + (uint32_t) bytesToInt32_bigEndian(table + s * sizeof(uint32_t)) : end;
+                    segments.push_back({p, q, std::min(segmentSize, targetLength - s * segmentSize)});
+                    p = q;
+                }
             }
-
-            for (i = 0; count < targetLength; i++) {
-                byteIndex = i >> 3; //i/8
-                r = i % 8;
-                if (((bytes[byteIndex] >> (7 - r)) & 0x01) == 0)
-                    n = n->left;
-                else
-                    n = n->right;
-
-                if (n->t) {
-                    out[count] = n->c + offset;
-                    n = t;
-                    count++;
+            bytes = end;
+            if (parallel_segments(segments.size())) {
+                std::vector<T> out(targetLength);
+                size_t segmentSize = segments[0].length;
+#pragma omp parallel for schedule(dynamic)
+                for (size_t s = 0; s < segments.size(); s++) {
+                    HuffmanSymbolStream(treeRoot, offset, {segments[s]}).next(out.data() + s * segmentSize, segments[s].length);
                 }
+                return std::unique_ptr<SymbolStream<T>>(new VectorSymbolStream<T>(std::move(out)));
             }
-            bytes += encodedLength;
-            return out;
+            return std::unique_ptr<SymbolStream<T>>(new HuffmanSymbolStream(treeRoot, offset, std::move(segments)));
         }
 
         //empty function
         void postprocess_decode() {
+            useSharedTree = false;
+            runTokens.reset();
             SZ_FreeHuffman();
         }
 
         //load Huffman tree
         void load(const uchar *&c, size_t &remaining_length) {
+            if (sharedTree) {
+                uchar flag;
+                read(flag, c, remaining_length);
+                useSharedTree = flag;
+                if (useSharedTree) {
+                    loaded = true;
+                    return;
+                }
+            }
             read(offset, c, remaining_length);
+            if (remaining_length < sizeof(int)) {
+                throw std::invalid_argument("truncated Huffman tree in the compressed data");
+            }
             nodeCount = bytesToInt32_bigEndian(c);
+            runTokens.reset();
+            bool legacy = huffman_legacy_format();
+            if (!legacy && nodeCount == (unsigned int) -1) {
+                dominant = offset;
+                skip(c, sizeof(int), remaining_length);
+                read(runBase, c, remaining_length);
+                runTokens = std::make_shared<HuffmanEncoder<T>>();
+                runTokens->load(c, remaining_length);
+                loaded = true;
+                return;
+            }
+            if (!legacy) {
+                if (nodeCount != 0) {
+                    throw std::invalid_argument("invalid Huffman tree in the compressed data");
+                }
+                if (remaining_length < sizeof(int) + sizeof(int)) {
+                    throw std::invalid_argument("truncated Huffman tree in the compressed data");
+                }
+                huffmanTree = createHuffmanTree(bytesToInt32_bigEndian(c + sizeof(int)) + 1, 0);
+                skip(c, sizeof(int) + sizeof(int), remaining_length);
+                load_lengths(c, remaining_length);
+                reserve_nodes(huffmanTree, 2 * huffmanTree->n_used + 1);
+                build_canonical_tree();
+                segmented = true;
+                loaded = true;
+                return;
+            }
+            // data version 3.2.0: node arrays
             int stateNum = bytesToInt32_bigEndian(c + sizeof(int)) * 2;
             size_t encodeStartIndex;
             if (nodeCount <= 256)
@@ -287,21 +498,355 @@ namespace SZ3 {
                         1 + 2 * nodeCount * sizeof(unsigned int) + nodeCount * sizeof(unsigned char) +
                         nodeCount * sizeof(T);
 
-            huffmanTree = createHuffmanTree(stateNum);
+            huffmanTree = createHuffmanTree(stateNum, nodeCount);
             treeRoot = reconstruct_HuffTree_from_bytes_anyStates(c + sizeof(int) + sizeof(int), nodeCount);
+            if (!treeRoot->t) {
+                code_lengths(treeRoot, 0);
+            }
+            segmented = false;
             c += sizeof(int) + sizeof(int) + encodeStartIndex;
             loaded = true;
         }
 
         bool isLoaded() { return loaded; }
 
+        /**
+         * Shared tree: one tree stored once for many arrays (see SZ_compress_batch), instead of one tree per array.
+         * learn_shared_tree() starts collecting the symbols passed to preprocess_encode by this encoder and its copies,
+         * build_shared_tree() builds the tree from them.
+         * From then on, preprocess_encode skips building a tree when the shared tree has a code for every symbol,
+         * and falls back to a tree of its own otherwise; save() records the choice in one byte.
+         * The shared tree is read-only once built, so encoders of different threads may use it at the same time.
+         */
+        void learn_shared_tree() {
+            sharedFrequency = std::make_shared<FrequencyMap>();
+        }
+
+        void build_shared_tree() {
+            if (sharedFrequency && !sharedFrequency->empty()) {
+                auto tree = std::make_shared<HuffmanEncoder<T>>();
+                tree->build_tree(*sharedFrequency);
+                tree->maxCodeLength = tree->depth(tree->treeRoot);
+                sharedTree = tree;
+            }
+            sharedFrequency.reset();
+        }
+
+        bool has_shared_tree() const { return sharedTree != nullptr; }
+
+        // size of save_shared_tree()
+        size_t shared_tree_size_est() const {
+            return sharedTree->size_est();
+        }
+
+        void save_shared_tree(uchar *&c) const {
+            sharedTree->save(c);
+        }
+
+        void load_shared_tree(const uchar *&c, size_t &remaining_length) {
+            auto tree = std::make_shared<HuffmanEncoder<T>>();
+            tree->load(c, remaining_length);
+            tree->maxCodeLength = tree->depth(tree->treeRoot);
+            sharedTree = tree;
+        }
+
+        // use the shared tree of another encoder, the tree pools stay separate
+        void use_shared_tree_of(const HuffmanEncoder<T> &other) {
+            sharedTree = other.sharedTree;
+        }
+
     private:
+        // encoded bytes [begin, end) of length symbols
+        struct Segment {
+            const uchar *begin, *end;
+            size_t length;
+        };
+
+        /**
+         * table-driven decoder: the next table_bits bits of the stream index a table giving the symbols whose codes
+         * they hold (up to two short codes at once) and the number of bits of these codes.
+         * Longer codes are rare, they are decoded by walking the tree bit by bit.
+         */
+        class HuffmanSymbolStream : public SymbolStream<T> {
+        public:
+            HuffmanSymbolStream(node root, T offset, std::vector<Segment> segments) :
+                    SymbolStream<T>(total_length(segments)), root(root), offset(offset), segments(std::move(segments)) {
+                if (!root->t) {
+                    table.resize(size_t(1) << table_bits);
+                    build_table(root, 0, 0);
+                    pair_codes();
+                }
+            }
+
+        protected:
+            void decode(T *out, size_t n) {
+                if (root->t) //root->t==1 means that all state values are the same (constant)
+                {
+                    std::fill_n(out, n, root->c + offset);
+                    return;
+                }
+                while (n > 0) {
+                    if (segmentLeft == 0) {
+                        const Segment &segment = segments[nextSegment++];
+                        pos = segment.begin;
+                        end = segment.end;
+                        segmentLeft = segment.length;
+                        bits = 0;
+                        available = 0;
+                    }
+                    size_t m = std::min(n, segmentLeft);
+                    decode_segment(out, m);
+                    out += m;
+                    n -= m;
+                    segmentLeft -= m;
+                }
+            }
+
+        private:
+            static size_t total_length(const std::vector<Segment> &segments) {
+                size_t length = 0;
+                for (const auto &segment: segments) {
+                    length += segment.length;
+                }
+                return length;
+            }
+
+            // decode n symbols of the current segment
+            void decode_segment(T *out, size_t n) {
+                size_t count = 0;
+                while (count < n) {
+                    refill();
+                    const TableEntry &e = table[bits >> (64 - table_bits)];
+                    if (e.count == 0 || e.bits[0] > available) {
+                        out[count++] = decode_slow();
+                    } else if (e.count == 2 && count + 1 < n && e.bits[1] <= available) {
+                        out[count++] = e.symbol[0];
+                        out[count++] = e.symbol[1];
+                        consume(e.bits[1]);
+                    } else {
+                        out[count++] = e.symbol[0];
+                        consume(e.bits[0]);
+                    }
+                }
+            }
+
+            static constexpr int table_bits = 11; // 2^11 entries of 12 bytes (int symbols) stay in L1 cache
+
+            struct TableEntry {
+                T symbol[2];
+                uchar count = 0; // codes held by the table_bits bits, 0 if the first one is longer
+                uchar bits[2]; // bits of the first code, of the first two codes
+            };
+
+            // one entry for every table_bits bits starting with the code of a leaf, for codes up to table_bits bits
+            void build_table(node n, size_t code, int len) {
+                if (n->t) {
+                    size_t first = code << (table_bits - len);
+                    for (size_t i = 0; i < (size_t(1) << (table_bits - len)); i++) {
+                        TableEntry &e = table[first + i];
+                        e.symbol[0] = n->c + offset;
+                        e.count = 1;
+                        e.bits[0] = e.bits[1] = len;
+                    }
+                    return;
+                }
+                if (len < table_bits) {
+                    build_table(n->left, code << 1, len + 1);
+                    build_table(n->right, (code << 1) | 1, len + 1);
+                }
+            }
+
+            // add the second code to the entries whose bits also hold it
+            void pair_codes() {
+                size_t mask = table.size() - 1;
+                for (size_t i = 0; i < table.size(); i++) {
+                    TableEntry &e = table[i];
+                    if (e.count == 1 && e.bits[0] < table_bits) {
+                        // the first bits[0] bits are shifted out, zeros come in: the second code must fit in the rest
+                        const TableEntry &f = table[(i << e.bits[0]) & mask];
+                        if (f.count > 0 && e.bits[0] + f.bits[0] <= table_bits) {
+                            e.symbol[1] = f.symbol[0];
+                            e.bits[1] = e.bits[0] + f.bits[0];
+                            e.count = 2;
+                        }
+                    }
+                }
+            }
+
+            // fill bits up to at least 56 bits, fewer at the end of the stream
+            void refill() {
+                if (end - pos >= 8) {
+                    bits |= (uint64_t) bytesToInt64_bigEndian(pos) >> available;
+                    pos += (63 - available) >> 3;
+                    available |= 56;
+                } else {
+                    while (available <= 56 && pos < end) {
+                        bits |= (uint64_t) *pos++ << (56 - available);
+                        available += 8;
+                    }
+                }
+            }
+
+            void consume(int n) {
+                bits <<= n;
+                available -= n;
+            }
+
+            T decode_slow() {
+                node t = root;
+                while (!t->t) {
+                    if (available == 0) {
+                        refill();
+                    }
+                    t = (bits >> 63) ? t->right : t->left;
+                    bits <<= 1;
+                    available -= available > 0;
+                }
+                return t->c + offset;
+            }
+
+            node root;
+            T offset;
+            std::vector<Segment> segments;
+            size_t nextSegment = 0, segmentLeft = 0; // symbols left in the current segment
+            const uchar *pos, *end; // next byte to read into bits, end of the current segment
+            uint64_t bits = 0; // next bits of the stream, from the most significant one
+            int available = 0; // number of bits read into bits
+            std::vector<TableEntry> table;
+        };
+
+        // symbols of the run-length mode, see choose_runs
+        class RunLengthSymbolStream : public SymbolStream<T> {
+        public:
+            RunLengthSymbolStream(std::unique_ptr<SymbolStream<T>> tokens, const uchar *pos, const uchar *end,
+                                  T dominant, T runBase, size_t length) :
+                    SymbolStream<T>(length), tokens(std::move(tokens)), pos(pos), end(end),
+                    dominant(dominant), runBase(runBase) {}
+
+        protected:
+            void decode(T *out, size_t n) {
+                while (n > 0) {
+                    if (run == 0) {
+                        T token = tokens->next();
+                        if (token < runBase) {
+                            *out++ = token;
+                            n--;
+                            continue;
+                        }
+                        int b = token - runBase;
+                        run = (size_t(1) << b) | read_bits(b);
+                    }
+                    size_t m = std::min(run, n);
+                    std::fill_n(out, m, dominant);
+                    out += m;
+                    n -= m;
+                    run -= m;
+                }
+            }
+
+        private:
+            size_t read_bits(int b) {
+                while (available < b) {
+                    bits = (bits << 8) | (pos < end ? *pos++ : 0);
+                    available += 8;
+                }
+                available -= b;
+                return (bits >> available) & ((size_t(1) << b) - 1);
+            }
+
+            std::unique_ptr<SymbolStream<T>> tokens;
+            const uchar *pos, *end;
+            T dominant, runBase;
+            size_t run = 0; // bins left in the current run
+            uint64_t bits = 0;
+            int available = 0;
+        };
+
+        std::shared_ptr<HuffmanTree> treePool;
         HuffmanTree *huffmanTree = NULL;
         node treeRoot;
         unsigned int nodeCount = 0;
         uchar sysEndianType; //0: little endian, 1: big endian
         bool loaded = false;
         T offset;
+        std::shared_ptr<FrequencyMap> sharedFrequency;
+        std::shared_ptr<HuffmanEncoder<T>> sharedTree;
+        bool useSharedTree = false;
+        int maxCodeLength = 0;
+        // run-length mode, see choose_runs
+        std::shared_ptr<HuffmanEncoder<T>> runTokens; // encoder of the tokens, null in plain mode
+        T dominant = 0, runBase = 0;
+        std::vector<T> tokens;
+        std::vector<uchar> runBits;
+        static constexpr int max_run_bits = 24; // longer runs are cut in runs below 2^(max_run_bits + 1)
+        size_t dominantCount = 0, encodedBits = 0; // of the last tree built
+        std::vector<uchar> codeLengths; // serialized by save()
+        static constexpr int max_code_length = 32;
+        bool segmented = true; // false for the streams of the trees saved as node arrays, encoded in one piece
+        static constexpr int segment_bits = 20;
+        static constexpr size_t segment_size = size_t(1) << segment_bits; // bins per segment of the encoded stream
+
+        // whether the segments are encoded or decoded in parallel
+        static bool parallel_segments(size_t segments) {
+#ifdef _OPENMP
+            return segments > 1 && omp_get_max_threads() > 1 && !omp_in_parallel();
+#else
+            return false;
+#endif
+        }
+
+        // encode num_bin bins from the next byte, write up to 8 bytes past the end
+        void encode_segment(const T *bins, size_t num_bin, uchar *&p) const {
+            uint64_t buffer = 0; // bits not written yet, from the most significant one
+            int bufferBits = 0;
+            for (size_t i = 0; i < num_bin; i++) {
+                int state = bins[i] - offset;
+                // codes have at most max_code_length (32) bits, so they fit after the bits left in the buffer
+                buffer |= huffmanTree->code[state] >> bufferBits;
+                bufferBits += huffmanTree->cout[state];
+                if (bufferBits >= 32) {
+                    int64ToBytes_bigEndian(p, buffer);
+                    p += 4;
+                    buffer <<= 32;
+                    bufferBits -= 32;
+                }
+            }
+            int64ToBytes_bigEndian(p, buffer);
+            p += (bufferBits + 7) / 8;
+        }
+
+        // whether the tree has a code for each of the bins
+        bool covers(const T *bins, size_t num_bin) const {
+            for (size_t i = 0; i < num_bin; i++) {
+                auto state = (int64_t) bins[i] - (int64_t) offset;
+                if (state < 0 || state >= huffmanTree->stateNum || !has_code(state)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // whether the tree has a code for each symbol of the (symbol, count) pairs
+        bool covers(const std::vector<std::pair<T, size_t>> &frequency) const {
+            for (const auto &f: frequency) {
+                auto state = (int64_t) f.first - (int64_t) offset;
+                if (state < 0 || state >= huffmanTree->stateNum || !has_code(state)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool has_code(int64_t state) const {
+            return huffmanTree->cout[state] || (treeRoot->t && treeRoot->c == state);
+        }
+
+        int depth(node n) const {
+            if (n->t) {
+                return 0;
+            }
+            return 1 + std::max(n->left ? depth(n->left) : 0, n->right ? depth(n->right) : 0);
+        }
 
 
         node reconstruct_HuffTree_from_bytes_anyStates(const unsigned char *bytes, uint nodeCount) {
@@ -433,6 +978,7 @@ namespace SZ3 {
                 n->c = c;
                 n->freq = freq;
                 n->t = 1;
+                n->left = n->right = NULL;
             } else {
                 n->left = a;
                 n->right = b;
@@ -444,9 +990,11 @@ namespace SZ3 {
         }
 
         node new_node2(T c, unsigned char t) {
-            huffmanTree->pool[huffmanTree->n_nodes].c = c;
-            huffmanTree->pool[huffmanTree->n_nodes].t = t;
-            return huffmanTree->pool + huffmanTree->n_nodes++;
+            node n = huffmanTree->pool + huffmanTree->n_nodes++;
+            n->c = c;
+            n->t = t;
+            n->left = n->right = NULL;
+            return n;
         }
 
         /* priority queue */
@@ -482,62 +1030,301 @@ namespace SZ3 {
             return n;
         }
 
-        /* walk the tree and put 0s and 1s */
-        /**
-         * @out1 should be set to 0.
-         * @out2 should be 0 as well.
-         * @index: the index of the byte
-         * */
-        void build_code(node n, int len, uint64_t out1, uint64_t out2) {
+        // length of the code of every leaf under n, its depth
+        void code_lengths(node n, int len) {
             if (n->t) {
-                huffmanTree->code[n->c] = (uint64_t *) malloc(2 * sizeof(uint64_t));
-                if (len <= 64) {
-                    (huffmanTree->code[n->c])[0] = out1 << (64 - len);
-                    (huffmanTree->code[n->c])[1] = out2;
-                } else {
-                    (huffmanTree->code[n->c])[0] = out1;
-                    (huffmanTree->code[n->c])[1] = out2 << (128 - len);
-                }
                 huffmanTree->cout[n->c] = (unsigned char) len;
+                huffmanTree->used[huffmanTree->n_used++] = n->c;
                 return;
             }
-            int index = len >> 6; //=len/64
-            if (index == 0) {
-                out1 = out1 << 1;
-                out1 = out1 | 0;
-                build_code(n->left, len + 1, out1, 0);
-                out1 = out1 | 1;
-                build_code(n->right, len + 1, out1, 0);
-            } else {
-                if (len % 64 != 0)
-                    out2 = out2 << 1;
-                out2 = out2 | 0;
-                build_code(n->left, len + 1, out1, out2);
-                out2 = out2 | 1;
-                build_code(n->right, len + 1, out1, out2);
+            code_lengths(n->left, len + 1);
+            code_lengths(n->right, len + 1);
+        }
+
+        /**
+         * Limit the code lengths to max_code_length bits: longer codes are cut to max_code_length bits, and shorter codes
+         * lengthened one by one until the lengths make a prefix code again (as in zlib); the most frequent symbols get the
+         * shortest codes. Codes of (almost) equal lengths are used instead if they are shorter in total, so that
+         * size_bound() still holds.
+         */
+        template<class Frequency>
+        void limit_lengths(const Frequency &frequency) {
+            std::vector<size_t> lengthCount(256, 0);
+            int maxLength = 0;
+            for (const auto &f: frequency) {
+                int len = huffmanTree->cout[f.first - offset];
+                lengthCount[len]++;
+                maxLength = std::max(maxLength, len);
+            }
+            if (maxLength <= max_code_length) {
+                return;
+            }
+            for (int len = max_code_length + 1; len <= maxLength; len++) {
+                lengthCount[max_code_length] += lengthCount[len];
+                lengthCount[len] = 0;
+            }
+            // Kraft sum, in units of 2^-max_code_length
+            uint64_t kraft = 0;
+            for (int len = 1; len <= max_code_length; len++) {
+                kraft += (uint64_t) lengthCount[len] << (max_code_length - len);
+            }
+            while (kraft > (uint64_t(1) << max_code_length)) {
+                lengthCount[max_code_length]--;
+                for (int len = max_code_length - 1; len > 0; len--) {
+                    if (lengthCount[len]) {
+                        lengthCount[len]--;
+                        lengthCount[len + 1] += 2;
+                        break;
+                    }
+                }
+                kraft--;
+            }
+
+            std::vector<std::pair<size_t, int>> order; // (count, state), most frequent first
+            for (const auto &f: frequency) {
+                order.emplace_back(f.second, f.first - offset);
+            }
+            std::sort(order.begin(), order.end(), [](const std::pair<size_t, int> &a, const std::pair<size_t, int> &b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+            // k codes of ceil(log2(k)) bits, or one bit less for the first ones, all extra bits longer
+            auto equal_lengths = [](std::vector<size_t> &count, size_t k, int extra) {
+                int bits = 0;
+                while ((size_t(1) << bits) < k) {
+                    bits++;
+                }
+                size_t shorter = (size_t(1) << bits) - k;
+                if (shorter) {
+                    count[bits - 1 + extra] += shorter;
+                }
+                count[bits + extra] += k - shorter;
+            };
+            auto total_bits = [&order](const std::vector<size_t> &count) {
+                size_t bits = 0, i = 0;
+                for (int len = 1; len <= max_code_length; len++) {
+                    for (size_t j = 0; j < count[len]; j++) {
+                        bits += order[i++].first * len;
+                    }
+                }
+                return bits;
+            };
+            std::vector<size_t> equalCount(256, 0), skewedCount(256, 0);
+            equal_lengths(equalCount, order.size(), 0);
+            // 1 bit for the most frequent symbol
+            skewedCount[1] = 1;
+            equal_lengths(skewedCount, order.size() - 1, 1);
+            const std::vector<size_t> *best = &lengthCount;
+            for (const auto *count: {&equalCount, &skewedCount}) {
+                if (total_bits(*count) < total_bits(*best)) {
+                    best = count;
+                }
+            }
+            size_t i = 0;
+            for (int len = 1; len <= max_code_length; len++) {
+                for (size_t j = 0; j < (*best)[len]; j++) {
+                    huffmanTree->cout[order[i++].second] = (unsigned char) len;
+                }
+            }
+        }
+
+        /**
+         * canonical codes of the lengths in cout: codes of the same length are consecutive in the order of the states,
+         * and follow the shorter ones. The lengths are thus enough to rebuild the codes.
+         */
+        void assign_canonical_codes() {
+            unsigned int *used = huffmanTree->used;
+            std::sort(used, used + huffmanTree->n_used);
+            uint64_t lengthCount[64] = {0}, nextCode[64];
+            for (unsigned int i = 0; i < huffmanTree->n_used; i++) {
+                lengthCount[huffmanTree->cout[used[i]]]++;
+            }
+            uint64_t code = 0;
+            for (int len = 1; len < 64; len++) {
+                code = (code + lengthCount[len - 1]) << 1;
+                nextCode[len] = code;
+            }
+            for (unsigned int i = 0; i < huffmanTree->n_used; i++) {
+                int len = huffmanTree->cout[used[i]];
+                huffmanTree->code[used[i]] = nextCode[len]++ << (64 - len);
+            }
+        }
+
+        // tree of the canonical codes, used to decode them
+        void build_canonical_tree() {
+            assign_canonical_codes();
+            treeRoot = new_node2(0, 0);
+            for (unsigned int u = 0; u < huffmanTree->n_used; u++) {
+                unsigned int i = huffmanTree->used[u];
+                int len = huffmanTree->cout[i];
+                node n = treeRoot;
+                for (int b = 0; b < len; b++) {
+                    node &child = ((huffmanTree->code[i] >> (63 - b)) & 1) ? n->right : n->left;
+                    if (!child) {
+                        child = new_node2(0, 0);
+                    }
+                    n = child;
+                }
+                n->c = i;
+                n->t = 1;
+            }
+            if (huffmanTree->n_used == 0) { // a single state, of code length 0
+                treeRoot->t = 1;
+                huffmanTree->code[0] = 0;
+            }
+            nodeCount = 2 * std::max(huffmanTree->n_used, 1U) - 1;
+        }
+
+        /**
+         * code lengths of the states [0, stateNum - 1), one byte for a length (< 0x40), for a run of zeros
+         * (0x80 + run, or 0x80 followed by the run in 4 bytes when longer than 127) or for 1 to 64 repetitions of the previous length
+         * (0x3F + repetitions). A single state has no code and no length.
+         */
+        std::vector<uchar> serialize_lengths() const {
+            std::vector<uchar> out;
+            const unsigned char *len = huffmanTree->cout;
+            const unsigned int *used = huffmanTree->used;
+            size_t state = 0; // the lengths of [0, state) are written
+            for (size_t u = 0; u < huffmanTree->n_used;) {
+                size_t zeros = used[u] - state;
+                if (zeros >= 0x80) {
+                    out.push_back(0x80);
+                    out.resize(out.size() + sizeof(int));
+                    int32ToBytes_bigEndian(out.data() + out.size() - sizeof(int), zeros);
+                } else if (zeros > 0) {
+                    out.push_back(0x80 + zeros);
+                }
+                size_t run = 1;
+                while (u + run < huffmanTree->n_used && used[u + run] == used[u] + run && len[used[u + run]] == len[used[u]]) {
+                    run++;
+                }
+                out.push_back(len[used[u]]);
+                for (size_t r = run - 1; r > 0;) {
+                    size_t n = std::min<size_t>(r, 64);
+                    out.push_back(0x3F + n);
+                    r -= n;
+                }
+                state = used[u] + run;
+                u += run;
+            }
+            return out;
+        }
+
+        // advance c by n bytes of the remaining_length left, throw if fewer are left
+        static void skip(const uchar *&c, size_t n, size_t &remaining_length) {
+            if (remaining_length < n) {
+                throw std::invalid_argument("truncated Huffman tree in the compressed data");
+            }
+            c += n;
+            remaining_length -= n;
+        }
+
+        /**
+         * read the code lengths written by serialize_lengths into cout.
+         * Throws std::invalid_argument if they run past remaining_length or a length is longer than max_code_length.
+         */
+        void load_lengths(const uchar *&c, size_t &remaining_length) {
+            size_t span = huffmanTree->stateNum - 1;
+            unsigned char *len = huffmanTree->cout;
+            for (size_t i = 0; span > 1 && i < span;) {
+                const uchar *pos = c;
+                skip(c, 1, remaining_length);
+                uchar b = *pos;
+                if (b < 0x40) {
+                    if (b > max_code_length) {
+                        throw std::invalid_argument("invalid Huffman code length in the compressed data");
+                    }
+                    if (b) {
+                        huffmanTree->used[huffmanTree->n_used++] = i;
+                    }
+                    len[i++] = b;
+                } else if (b < 0x80) {
+                    size_t run = std::min<size_t>(b - 0x3F, span - i);
+                    uchar repeated = i ? len[i - 1] : 0;
+                    for (size_t r = 0; r < run; r++, i++) {
+                        if (repeated) {
+                            huffmanTree->used[huffmanTree->n_used++] = i;
+                        }
+                        len[i] = repeated;
+                    }
+                } else {
+                    size_t run = b - 0x80;
+                    if (run == 0) {
+                        pos = c;
+                        skip(c, sizeof(int), remaining_length);
+                        run = (uint32_t) bytesToInt32_bigEndian(pos);
+                    }
+                    run = std::min(run, span - i);
+                    std::fill_n(len + i, run, 0);
+                    i += run;
+                }
             }
         }
 
         /**
          * Compute the frequency of the data and build the Huffman tree
+         * Data within a range of max(length, 2^16) values, such as quantization bins, are counted in an array,
+         * on all OpenMP threads for long data; other data in a hash map.
          * @param HuffmanTree* huffmanTree (output)
          * @param int *s (input)
          * @param size_t length (input)
          * */
         void init(const T *s, size_t length) {
-            T max = s[0];
-            offset = s[0]; //offset is min
+            bool parallel = parallel_segments((length + segment_size - 1) / segment_size);
+            T lo = s[0], hi = s[0];
+#pragma omp parallel for reduction(min:lo) reduction(max:hi) if(parallel)
+            for (size_t i = 0; i < length; i++) {
+                lo = std::min(lo, s[i]);
+                hi = std::max(hi, s[i]);
+            }
+            size_t range = (size_t) ((int64_t) hi - (int64_t) lo) + 1;
+            if (range <= std::max<size_t>(length, 1 << 16)) {
+                std::vector<size_t> count(range, 0);
+                if (parallel) {
+#pragma omp parallel
+                    {
+                        std::vector<size_t> local(range, 0);
+#pragma omp for nowait
+                        for (size_t i = 0; i < length; i++) {
+                            local[s[i] - lo]++;
+                        }
+#pragma omp critical
+                        for (size_t r = 0; r < range; r++) {
+                            count[r] += local[r];
+                        }
+                    }
+                } else {
+                    for (size_t i = 0; i < length; i++) {
+                        count[s[i] - lo]++;
+                    }
+                }
+                std::vector<std::pair<T, size_t>> used;
+                for (size_t r = 0; r < range; r++) {
+                    if (count[r]) {
+                        used.emplace_back((T) (lo + r), count[r]);
+                    }
+                }
+                build_tree(used);
+                return;
+            }
 
-            #if INTPTR_MAX == INT64_MAX // 64bit system
-                ska::unordered_map<T, size_t> frequency;
-            #else // most likely 32bit system
-                std::unordered_map<T, size_t> frequency;
-            #endif // INTPTR_MAX == INT64_MAX
+            FrequencyMap frequency;
 
             for (size_t i = 0; i < length; i++) {
                 frequency[s[i]]++;
             }
 
+            build_tree(frequency);
+        }
+
+        /**
+         * Build the Huffman tree from the frequency of each symbol
+         * @param frequency (input), (symbol, count) pairs, not empty
+         * */
+        template<class Frequency>
+        void build_tree(const Frequency &frequency) {
+            T max = frequency.begin()->first;
+            offset = frequency.begin()->first; //offset is min
+
             for (const auto &kv: frequency) {
                 auto k = kv.first;
                 if (k > max) {
@@ -549,7 +1336,8 @@ namespace SZ3 {
             }
 
             int stateNum = max - offset + 2;
-            huffmanTree = createHuffmanTree(stateNum);
+            // leaves and inner nodes of the Huffman tree, then of the canonical tree
+            huffmanTree = createHuffmanTree(stateNum, 4 * frequency.size());
 
             for (const auto &f: frequency) {
                 qinsert(new_node(f.second, f.first - offset, 0, 0));
@@ -558,26 +1346,87 @@ namespace SZ3 {
             while (huffmanTree->qend > 2)
                 qinsert(new_node(0, 0, qremove(), qremove()));
 
-            build_code(huffmanTree->qq[1], 0, 0, 0);
-            treeRoot = huffmanTree->qq[1];
+            if (!huffmanTree->qq[1]->t) {
+                code_lengths(huffmanTree->qq[1], 0);
+                limit_lengths(frequency);
+            }
+            build_canonical_tree();
+            codeLengths = serialize_lengths();
 
+            dominantCount = 0;
+            encodedBits = 0;
+            for (const auto &f: frequency) {
+                if (f.second > dominantCount) {
+                    dominant = f.first;
+                    dominantCount = f.second;
+                }
+                encodedBits += f.second * huffmanTree->cout[f.first - offset];
+            }
         }
 
-        template<class T1>
-        void pad_tree(T1 *L, T1 *R, T *C, unsigned char *t, unsigned int i, node root) {
-            C[i] = root->c;
-            t[i] = root->t;
-            node lroot = root->left;
-            if (lroot != 0) {
-                huffmanTree->n_inode++;
-                L[i] = huffmanTree->n_inode;
-                pad_tree(L, R, C, t, huffmanTree->n_inode, lroot);
+        /**
+         * Run-length mode: when one symbol is most of the bins (e.g., the zero quantization index at large error bounds),
+         * its code still costs at least 1 bit per bin. Its runs are then coded as tokens instead: a run of length L
+         * is the token runBase + b, with b = floor(log2(L)), and the b low bits of L go to a bit stream of their own;
+         * the other bins are tokens of their own. The tokens are Huffman coded.
+         * The mode is kept only if it is smaller than the plain codes, so that size_bound() holds.
+         */
+        void choose_runs(const T *bins, size_t num_bin) {
+            runTokens.reset();
+            tokens.clear();
+            runBits.clear();
+            T base = offset + (T) (huffmanTree->stateNum - 1); // past the largest symbol
+            // below 3/4 of the bins, the runs are seldom long enough to pay for their tokens
+            if (encodedBits == 0 || dominantCount * 4 < num_bin * 3 || base > std::numeric_limits<T>::max() - max_run_bits) {
+                return;
+            }
+            // a run before every other bin at most
+            tokens.reserve(2 * (num_bin - dominantCount) + 1);
+            const size_t maxRun = (size_t(1) << (max_run_bits + 1)) - 1;
+            uint64_t buffer = 0;
+            int bufferBits = 0;
+            for (size_t i = 0; i < num_bin;) {
+                if (bins[i] != dominant) {
+                    tokens.push_back(bins[i++]);
+                    continue;
+                }
+                size_t j = i + 1, last = std::min(num_bin, i + maxRun);
+                while (j < last && bins[j] == dominant) {
+                    j++;
+                }
+                size_t length = j - i;
+                i = j;
+                int b = 0;
+                while (length >> (b + 1)) {
+                    b++;
+                }
+                tokens.push_back(base + (T) b);
+                buffer = (buffer << b) | (length - (size_t(1) << b));
+                bufferBits += b;
+                while (bufferBits >= 8) {
+                    bufferBits -= 8;
+                    runBits.push_back((uchar) (buffer >> bufferBits));
+                }
+            }
+            if (bufferBits > 0) {
+                runBits.push_back((uchar) (buffer << (8 - bufferBits)));
             }
-            node rroot = root->right;
-            if (rroot != 0) {
-                huffmanTree->n_inode++;
-                R[i] = huffmanTree->n_inode;
-                pad_tree(L, R, C, t, huffmanTree->n_inode, rroot);
+
+            auto encoder = std::make_shared<HuffmanEncoder<T>>();
+            encoder->init(tokens.data(), tokens.size());
+            // at least the plain size (without the flag counted by size_est), at most the run-length size
+            size_t segments = (num_bin + segment_size - 1) / segment_size;
+            size_t tokenSegments = (tokens.size() + segment_size - 1) / segment_size;
+            size_t plainSize = size_est() - 1 + sizeof(size_t) + 1 + (segments - 1) * sizeof(uint32_t) + encodedBits / 8;
+            size_t runSize = 1 + sizeof(T) + sizeof(int) + sizeof(T) + encoder->size_est()
+                             + sizeof(size_t) + sizeof(size_t) + 1 + tokenSegments * (sizeof(uint32_t) + 1) + encoder->encodedBits / 8
+                             + sizeof(size_t) + runBits.size();
+            if (runSize < plainSize) {
+                runTokens = encoder;
+                runBase = base;
+            } else {
+                tokens.clear();
+                runBits.clear();
             }
         }
 
@@ -601,53 +1450,18 @@ namespace SZ3 {
             }
         }
 
-        template<class T1>
-        unsigned int convert_HuffTree_to_bytes_anyStates(unsigned int nodeCount, unsigned char *out) {
-            T1 *L = (T1 *) malloc(nodeCount * sizeof(T1));
-            memset(L, 0, nodeCount * sizeof(T1));
-            T1 *R = (T1 *) malloc(nodeCount * sizeof(T1));
-            memset(R, 0, nodeCount * sizeof(T1));
-            T *C = (T *) malloc(nodeCount * sizeof(T));
-            memset(C, 0, nodeCount * sizeof(T));
-            unsigned char *t = (unsigned char *) malloc(nodeCount * sizeof(unsigned char));
-            memset(t, 0, nodeCount * sizeof(unsigned char));
-
-            pad_tree(L, R, C, t, 0, huffmanTree->qq[1]);
-
-            unsigned int totalSize =
-                    1 + 2 * nodeCount * sizeof(T1) + nodeCount * sizeof(unsigned char) + nodeCount * sizeof(T);
-            //*out = (unsigned char*)malloc(totalSize);
-            out[0] = (unsigned char) sysEndianType;
-            memcpy(out + 1, L, nodeCount * sizeof(T1));
-            memcpy(out + 1 + nodeCount * sizeof(T1), R, nodeCount * sizeof(T1));
-            memcpy(out + 1 + 2 * nodeCount * sizeof(T1), C, nodeCount * sizeof(T));
-            memcpy(out + 1 + 2 * nodeCount * sizeof(T1) + nodeCount * sizeof(T), t, nodeCount * sizeof(unsigned char));
-
-            free(L);
-            free(R);
-            free(C);
-            free(t);
-            return totalSize;
+        // release the tree, its memory stays in the pool for the next tree
+        void SZ_FreeHuffman() {
+            huffmanTree = NULL;
         }
 
-        void SZ_FreeHuffman() {
-            if (huffmanTree != NULL) {
-                size_t i;
-                free(huffmanTree->pool);
-                huffmanTree->pool = NULL;
-                free(huffmanTree->qqq);
-                huffmanTree->qqq = NULL;
-                for (i = 0; i < huffmanTree->stateNum; i++) {
-                    if (huffmanTree->code[i] != NULL)
-                        free(huffmanTree->code[i]);
-                }
-                free(huffmanTree->code);
-                huffmanTree->code = NULL;
-                free(huffmanTree->cout);
-                huffmanTree->cout = NULL;
-                free(huffmanTree);
-                huffmanTree = NULL;
-            }
+        static void free_tree_pool(HuffmanTree *tree) {
+            free(tree->pool);
+            free(tree->qqq);
+            free(tree->code);
+            free(tree->cout);
+            free(tree->used);
+            free(tree);
         }
 
     };
@@ -0,0 +1,430 @@
+#ifndef _SZ_RANS_ENCODER_HPP
+#define _SZ_RANS_ENCODER_HPP
+
+#include "SZ3/def.hpp"
+#include "SZ3/encoder/Encoder.hpp"
+#include "SZ3/utils/MemoryUtil.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SZ3 {
+
+    /**
+     * Interleaved rANS (range asymmetric numeral systems) encoder.
+     * The frequencies of the symbols are scaled to a total of 2^scale_bits, a symbol costs log2(2^scale_bits / freq) bits:
+     * close to arithmetic coding, and below the 1 bit per symbol of Huffman codes when one symbol dominates
+     * (e.g., the zero quantization index at large error bounds).
+     *
+     * Symbol i is coded by state i % lanes. The states are independent, so the decoder has lanes symbols in flight
+     * instead of waiting for the previous one. States are 32 bits and are renormalized by 16-bit words,
+     * the encoder divides by the frequencies through their reciprocals (as in ryg_rans).
+     *
+     * The max_symbols - 1 most frequent symbols have a frequency of their own, the others share an escape symbol
+     * and are stored verbatim after it.
+     */
+    template<class T>
+    class RansEncoder : public concepts::EncoderInterface<T> {
+    public:
+        static constexpr int lanes = 4;
+        static constexpr uint32_t scale_bits = 15;
+        static constexpr uint32_t scale = 1u << scale_bits;
+        static constexpr uint32_t state_lower_bound = 1u << 15; // states stay in [2^15, 2^31)
+        static constexpr size_t max_symbols = 4096;
+
+        void preprocess_encode(const std::vector<T> &bins, int stateNum) {
+            std::vector<std::pair<T, size_t>> counts;
+            if (!bins.empty()) {
+                T min = bins[0], max = bins[0];
+                for (auto bin: bins) {
+                    min = std::min(min, bin);
+                    max = std::max(max, bin);
+                }
+                int64_t lo = min;
+                uint64_t range = (uint64_t) ((int64_t) max - lo) + 1;
+                if (range <= std::max<uint64_t>(bins.size(), 1 << 16)) {
+                    std::vector<size_t> frequency(range, 0);
+                    for (auto bin: bins) {
+                        frequency[(int64_t) bin - lo]++;
+                    }
+                    for (size_t i = 0; i < range; i++) {
+                        if (frequency[i]) {
+                            counts.emplace_back((T) (lo + (int64_t) i), frequency[i]);
+                        }
+                    }
+                } else {
+                    std::unordered_map<T, size_t> frequency;
+                    for (auto bin: bins) {
+                        frequency[bin]++;
+                    }
+                    counts.assign(frequency.begin(), frequency.end());
+                }
+            }
+            build_model(counts);
+        }
+
+        void preprocess_encode_counted(const std::vector<T> &bins, const std::vector<size_t> &frequency) {
+            std::vector<std::pair<T, size_t>> counts;
+            for (size_t i = 0; i < frequency.size(); i++) {
+                if (frequency[i]) {
+                    counts.emplace_back((T) i, frequency[i]);
+                }
+            }
+            build_model(counts);
+        }
+
+        void postprocess_encode() {}
+
+        void preprocess_decode() {}
+
+        void postprocess_decode() {}
+
+        /**
+         * worst-case size of save() + encode(), known before the model is built
+         * @param num number of symbols to be encoded
+         * @param stateNum stateNum > 0 indicates the symbols are in [0, stateNum). stateNum == 0 means no such guarantee
+         * @param rawBits bits stored outside the encoder for every occurrence of symbol 0, they are included in the bound
+         */
+        size_t size_bound(size_t num, int stateNum, size_t rawBits = 0) const {
+            size_t symbols = std::max<size_t>(1, stateNum > 0 ? std::min<size_t>(num, stateNum) : num);
+            bool escapes = symbols > max_symbols;
+            symbols = std::min(symbols, max_symbols);
+            size_t modelSize = sizeof(uint32_t) + 1 + symbols * (sizeof(T) + sizeof(uint16_t));
+            // a symbol emits one word at most, the states are flushed in 2 words each
+            size_t bound = modelSize + 2 * sizeof(size_t) + (num + 2 * lanes) * sizeof(uint16_t) + num * rawBits / 8 + 1;
+            if (escapes) {
+                bound += num * sizeof(T);
+            }
+            return bound;
+        }
+
+        size_t size_est() {
+            return sizeof(uint32_t) + 1 + symbols.size() * (sizeof(T) + sizeof(uint16_t));
+        }
+
+        /**
+         * the words of the states (count and words): the final states first, then the words emitted while encoding,
+         * in the order the decoder reads them; then the escaped symbols (count and values)
+         */
+        size_t encode(const std::vector<T> &bins, uchar *&bytes) {
+            uchar *bytes0 = bytes;
+            size_t n = bins.size();
+            // the words are written backward from the end of their worst-case size, then moved to the front
+            uchar *words = bytes + sizeof(size_t);
+            uchar *ptr = words + (n + 2 * lanes) * sizeof(uint16_t);
+            std::vector<T> escaped;
+            uint32_t state[lanes];
+            std::fill_n(state, lanes, state_lower_bound);
+            auto encode_symbol = [&](uint32_t &x, T bin) {
+                uint32_t idx = index_of(bin);
+                if (idx == escape_index) {
+                    escaped.push_back(bin);
+                }
+                const EncodeSymbol &sym = enc[idx];
+                // without branches, they would be mispredicted: the word is stored in any case, and kept if emitted
+                bool emit = x >= sym.x_max;
+                uint16_t word = (uint16_t) x;
+                memcpy(ptr - sizeof(uint16_t), &word, sizeof(uint16_t));
+                ptr -= emit * sizeof(uint16_t);
+                x = emit ? x >> 16 : x;
+                uint32_t q = (uint32_t) (((uint64_t) x * sym.rcp_freq) >> 32) >> sym.rcp_shift;
+                x += sym.bias + q * sym.cmpl_freq;
+            };
+            // rANS decodes in the reverse order of encoding: the bins past the last full group of lanes first
+            size_t i = n;
+            while (i % lanes) {
+                i--;
+                encode_symbol(state[i % lanes], bins[i]);
+            }
+            while (i > 0) {
+                i -= lanes;
+                for (int j = lanes; j-- > 0;) {
+                    encode_symbol(state[j], bins[i + j]);
+                }
+            }
+            for (int j = lanes; j-- > 0;) {
+                ptr -= sizeof(uint32_t);
+                memcpy(ptr, &state[j], sizeof(uint32_t));
+            }
+            size_t wordCount = (words + (n + 2 * lanes) * sizeof(uint16_t) - ptr) / sizeof(uint16_t);
+            memmove(words, ptr, wordCount * sizeof(uint16_t));
+            write(wordCount, bytes);
+            bytes += wordCount * sizeof(uint16_t);
+            std::reverse(escaped.begin(), escaped.end());
+            write(escaped.size(), bytes);
+            write(escaped.data(), escaped.size(), bytes);
+            return bytes - bytes0;
+        }
+
+        std::vector<T> decode(const uchar *&bytes, size_t targetLength) {
+            std::vector<T> out(targetLength);
+            decode_stream(bytes, targetLength)->next(out.data(), targetLength);
+            return out;
+        }
+
+        /**
+         * decode the symbols on demand, see SymbolStream
+         * The stream uses the model of this encoder: it must be read before the next load().
+         */
+        std::unique_ptr<SymbolStream<T>> decode_stream(const uchar *&bytes, size_t targetLength) {
+            size_t wordCount, escapedCount;
+            read(wordCount, bytes);
+            const uchar *words = bytes;
+            bytes += wordCount * sizeof(uint16_t);
+            read(escapedCount, bytes);
+            const uchar *escaped = bytes;
+            bytes += escapedCount * sizeof(T);
+            return std::unique_ptr<SymbolStream<T>>(new RansSymbolStream(*this, escaped, words, targetLength));
+        }
+
+        // number of symbols, escape flag, then the symbols and their frequencies
+        void save(uchar *&c) {
+            write((uint32_t) symbols.size(), c);
+            write((uchar) (escape_index != no_escape), c);
+            write(symbols.data(), symbols.size(), c);
+            for (auto f: freq) {
+                write((uint16_t) f, c);
+            }
+        }
+
+        void load(const uchar *&c, size_t &remaining_length) {
+            uint32_t k;
+            uchar hasEscape;
+            read(k, c, remaining_length);
+            read(hasEscape, c, remaining_length);
+            symbols.resize(k);
+            read(symbols.data(), k, c, remaining_length);
+            freq.resize(k);
+            for (auto &f: freq) {
+                uint16_t f16;
+                read(f16, c, remaining_length);
+                f = f16;
+            }
+            escape_index = hasEscape ? k - 1 : no_escape;
+            start.assign(k + 1, 0);
+            for (uint32_t i = 0; i < k; i++) {
+                start[i + 1] = start[i] + freq[i];
+            }
+            slots.resize(scale);
+            for (uint32_t i = 0; i < k; i++) {
+                std::fill(slots.begin() + start[i], slots.begin() + start[i + 1], (uint16_t) i);
+            }
+        }
+
+    private:
+        static constexpr uint32_t no_escape = UINT32_MAX;
+
+        struct EncodeSymbol {
+            uint32_t x_max; // states from x_max on emit a word before the symbol is encoded
+            uint32_t rcp_freq; // reciprocal of freq, with rcp_shift: x / freq == (x * rcp_freq >> 32) >> rcp_shift
+            uint32_t bias;
+            uint32_t cmpl_freq; // scale - freq
+            uint32_t rcp_shift;
+        };
+
+        class RansSymbolStream : public SymbolStream<T> {
+        public:
+            RansSymbolStream(const RansEncoder &model, const uchar *escaped, const uchar *words, size_t length) :
+                    SymbolStream<T>(length), model(model), escaped(escaped), words(words) {
+                memcpy(state, this->words, sizeof(state));
+                this->words += sizeof(state);
+            }
+
+        protected:
+            void decode(T *out, size_t n) {
+                const uint16_t *slots = model.slots.data();
+                const uint32_t *freq = model.freq.data(), *start = model.start.data();
+                const T *symbols = model.symbols.data();
+                const uint32_t escape_index = model.escape_index;
+                // local copies: out may alias the states (e.g., int and uint32_t), which would keep them in memory
+                uint32_t x[lanes];
+                std::copy_n(state, lanes, x);
+                const uchar *w = words, *e = escaped;
+                auto decode_symbol = [&](uint32_t &xj, T &symbol) {
+                    uint32_t s = xj & (scale - 1);
+                    uint32_t idx = slots[s];
+                    if (idx == escape_index) {
+                        memcpy(&symbol, e, sizeof(T));
+                        e += sizeof(T);
+                    } else {
+                        symbol = symbols[idx];
+                    }
+                    xj = freq[idx] * (xj >> scale_bits) + s - start[idx];
+                    if (xj < state_lower_bound) {
+                        uint16_t word;
+                        memcpy(&word, w, sizeof(uint16_t));
+                        w += sizeof(uint16_t);
+                        xj = (xj << 16) | word;
+                    }
+                };
+                size_t k = 0;
+                for (; k < n && i % lanes; k++, i++) {
+                    decode_symbol(x[i % lanes], out[k]);
+                }
+                for (; k + lanes <= n; k += lanes, i += lanes) {
+                    for (int j = 0; j < lanes; j++) {
+                        decode_symbol(x[j], out[k + j]);
+                    }
+                }
+                for (; k < n; k++, i++) {
+                    decode_symbol(x[i % lanes], out[k]);
+                }
+                std::copy_n(x, lanes, state);
+                words = w;
+                escaped = e;
+            }
+
+        private:
+            const RansEncoder &model;
+            const uchar *escaped, *words;
+            uint32_t state[lanes];
+            size_t i = 0;
+        };
+
+        /**
+         * keep the most frequent symbols (and an escape symbol for the others),
+         * scale their counts to frequencies summing to 2^scale_bits and set up the encoding tables
+         */
+        void build_model(std::vector<std::pair<T, size_t>> &counts) {
+            size_t escapeCount = 0;
+            if (counts.size() > max_symbols) {
+                std::nth_element(counts.begin(), counts.begin() + (max_symbols - 1), counts.end(),
+                                 [](const std::pair<T, size_t> &a, const std::pair<T, size_t> &b) {
+                                     return a.second > b.second;
+                                 });
+                for (size_t i = max_symbols - 1; i < counts.size(); i++) {
+                    escapeCount += counts[i].second;
+                }
+                counts.resize(max_symbols - 1);
+            }
+            std::sort(counts.begin(), counts.end());
+            symbols.clear();
+            std::vector<size_t> count;
+            for (auto &c: counts) {
+                symbols.push_back(c.first);
+                count.push_back(c.second);
+            }
+            escape_index = no_escape;
+            if (escapeCount) {
+                escape_index = symbols.size();
+                symbols.push_back(T());
+                count.push_back(escapeCount);
+            }
+            normalize(count);
+
+            size_t k = symbols.size();
+            start.assign(k + 1, 0);
+            enc.resize(k);
+            for (size_t i = 0; i < k; i++) {
+                start[i + 1] = start[i] + freq[i];
+                EncodeSymbol &sym = enc[i];
+                sym.x_max = ((state_lower_bound >> scale_bits) << 16) * freq[i];
+                sym.cmpl_freq = scale - freq[i];
+                if (freq[i] < 2) {
+                    // x / 1 == (x * (2^32 - 1) >> 32) + 1 for 0 < x < 2^32, the + 1 goes to the bias
+                    sym.rcp_freq = ~0u;
+                    sym.rcp_shift = 0;
+                    sym.bias = start[i] + scale - 1;
+                } else {
+                    uint32_t shift = 0;
+                    while (freq[i] > (1u << shift)) {
+                        shift++;
+                    }
+                    sym.rcp_freq = (uint32_t) (((uint64_t(1) << (shift + 31)) + freq[i] - 1) / freq[i]);
+                    sym.rcp_shift = shift - 1;
+                    sym.bias = start[i];
+                }
+            }
+
+            // symbol -> index, a table over the range of the symbols unless they are too sparse
+            dense.clear();
+            sparse.clear();
+            if (k > 0) {
+                int64_t lo = symbols[0], hi = symbols[escape_index == no_escape ? k - 1 : k - 2];
+                uint64_t range = (uint64_t) (hi - lo) + 1;
+                uint32_t missing = escape_index == no_escape ? 0 : escape_index;
+                if (range <= std::max<uint64_t>(4 * k, 1 << 16)) {
+                    offset = lo;
+                    dense.assign(range, missing);
+                    for (size_t i = 0; i < k; i++) {
+                        if (i != escape_index) {
+                            dense[(int64_t) symbols[i] - lo] = i;
+                        }
+                    }
+                } else {
+                    for (size_t i = 0; i < k; i++) {
+                        if (i != escape_index) {
+                            sparse[symbols[i]] = i;
+                        }
+                    }
+                }
+            }
+        }
+
+        // frequencies proportional to count, at least 1, summing to scale
+        void normalize(const std::vector<size_t> &count) {
+            size_t k = count.size();
+            freq.assign(k, 0);
+            if (k == 0) {
+                return;
+            }
+            uint64_t total = 0;
+            for (auto c: count) {
+                total += c;
+            }
+            int64_t sum = 0;
+            size_t largest = 0;
+            for (size_t i = 0; i < k; i++) {
+                freq[i] = std::max<uint64_t>(1, (uint64_t) ((double) count[i] * scale / total));
+                sum += freq[i];
+                if (count[i] > count[largest]) {
+                    largest = i;
+                }
+            }
+            if (sum <= (int64_t) scale) {
+                freq[largest] += scale - sum;
+                return;
+            }
+            // the symbols raised to a frequency of 1 went over: take back from the most frequent ones
+            std::vector<size_t> order(k);
+            for (size_t i = 0; i < k; i++) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return freq[a] > freq[b]; });
+            while (sum > (int64_t) scale) {
+                for (size_t i = 0; i < k && sum > (int64_t) scale && freq[order[i]] > 1; i++) {
+                    freq[order[i]]--;
+                    sum--;
+                }
+            }
+        }
+
+        uint32_t index_of(T bin) const {
+            if (!dense.empty()) {
+                uint64_t d = (uint64_t) ((int64_t) bin - offset);
+                return d < dense.size() ? dense[d] : escape_index;
+            }
+            auto it = sparse.find(bin);
+            return it == sparse.end() ? escape_index : it->second;
+        }
+
+        std::vector<T> symbols; // symbols with a frequency, in increasing order, then the escape symbol if any
+        std::vector<uint32_t> freq, start; // start[i] = freq[0] + ... + freq[i - 1]
+        uint32_t escape_index = no_escape;
+
+        // encoding
+        std::vector<EncodeSymbol> enc;
+        std::vector<uint32_t> dense;
+        int64_t offset = 0;
+        std::unordered_map<T, uint32_t> sparse;
+
+        // decoding: index of the symbol of every slot in [0, scale)
+        std::vector<uint16_t> slots;
+    };
+}
+
+#endif
@@ -10,6 +10,8 @@
 #include "SZ3/utils/MemoryUtil.hpp"
 #include "SZ3/utils/FileUtil.hpp"
 #include "SZ3/lossless/Lossless.hpp"
+#include <cstring>
+#include <stdexcept>
 
 namespace SZ3 {
     class Lossless_bypass : public concepts::LosslessInterface {
@@ -17,12 +19,22 @@ namespace SZ3 {
      public:
         
         size_t compress(uchar *src, size_t srcLen, uchar *dst, size_t dstCap) {
-            dst = src;
+            if (dstCap < srcLen) {
+                throw CapacityError("dstCap too small for the data stored by the lossless module");
+            }
+            memcpy(dst, src, srcLen);
             return srcLen;
         }
         
         size_t decompress(const uchar *src, const size_t srcLen, uchar *dst, size_t dstCap) {
-            dst = (uchar *) src;
+            if (srcLen > dstCap) {
+                throw std::invalid_argument("dstCap too small for the data stored by the lossless module");
+            }
+            memcpy(dst, src, srcLen);
+            return srcLen;
+        }
+        
+        size_t size_bound(size_t srcLen) const {
             return srcLen;
         }
     };
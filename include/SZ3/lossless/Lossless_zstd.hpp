@@ -10,14 +10,44 @@
 #include "SZ3/utils/MemoryUtil.hpp"
 #include "SZ3/utils/FileUtil.hpp"
 #include "SZ3/lossless/Lossless.hpp"
+#include "SZ3/utils/Config.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace SZ3 {
+    /**
+     * zstd lossless module
+     * The zstd compression and decompression contexts are created on first use and shared by the copies of this module,
+     * so a module kept across calls (e.g., in SZ3::Context) skips their setup. A context serves one call at a time.
+     * Compression goes through the advanced API, so it can be spread over zstd worker threads (see set_params).
+     * Data zstd would barely shrink may be stored as is instead (LOSSLESS_BYPASS and LOSSLESS_AUTO), behind bypass_magic
+     * and its length (size_t) in place of the zstd frame, so decompress tells the two apart without any setting.
+     * Data is also stored as is when its zstd frame does not fit dstCap, so srcLen + 12 bytes are always enough.
+     */
     class Lossless_zstd : public concepts::LosslessInterface {
      
      public:
         Lossless_zstd() = default;
         
-        Lossless_zstd(int comp_level) : compression_level(comp_level) {};
+        Lossless_zstd(int comp_level, int nb_workers = 0) : compression_level(comp_level), nb_workers(nb_workers) {};
+        
+        /**
+         * set the parameters of the following compress calls
+         * @param comp_level zstd compression level
+         * @param nb_workers zstd worker threads (ZSTD_c_nbWorkers), 0 compresses in the calling thread.
+         * They are ignored if zstd is built without ZSTD_MULTITHREAD. The output differs from the single-threaded one,
+         * but it is decompressed the same way.
+         * @param mode LOSSLESS_ZSTD, LOSSLESS_BYPASS (store as is) or LOSSLESS_AUTO (store as is when a sample barely compresses)
+         */
+        void set_params(int comp_level, int nb_workers, uint8_t mode = LOSSLESS_ZSTD) {
+            compression_level = comp_level;
+            this->nb_workers = nb_workers;
+            this->mode = mode;
+        }
         
         size_t compress(uchar *src, size_t srcLen, uchar *dst, size_t dstCap) {
 //            size_t estimatedCompressedSize = std::max(size_t(srcLen * 1.2), size_t(400));
@@ -28,7 +58,25 @@ namespace SZ3 {
 //                throw std::invalid_argument(
 //                    "dstCap not large enough for zstd");
 //            }
-            return ZSTD_compress(dst, dstCap, src, srcLen, compression_level);
+            if (mode == LOSSLESS_BYPASS || (mode == LOSSLESS_AUTO && !worth_compressing(src, srcLen))) {
+                return store(src, srcLen, dst, dstCap);
+            }
+            if (!cctx) {
+                cctx = std::shared_ptr<ZSTD_CCtx>(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            }
+            // the parameters stick to the context, which is shared by modules that may be set up differently
+            reset_session();
+            set_parameter(ZSTD_c_compressionLevel, compression_level);
+            set_parameter(ZSTD_c_nbWorkers, supported_workers(nb_workers));
+            size_t cmpSize = ZSTD_compress2(cctx.get(), dst, dstCap, src, srcLen);
+            if (ZSTD_isError(cmpSize)) {
+                // zstd only runs out of room below its bound: the data is stored as is, if that fits
+                if (dstCap < ZSTD_compressBound(srcLen)) {
+                    return store(src, srcLen, dst, dstCap);
+                }
+                throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(cmpSize));
+            }
+            return cmpSize;
 //            dstLen += sizeof(size_t);
 //            return compressBytes;
         }
@@ -39,13 +87,110 @@ namespace SZ3 {
 //            read(dataLength, dataPos, compressedSize);
 
 //            uchar *oriData = new uchar[dataLength];
-            return ZSTD_decompress(dst, dstCap, src, srcLen);
+            if (srcLen >= sizeof(bypass_magic) && memcmp(src, bypass_magic, sizeof(bypass_magic)) == 0) {
+                if (srcLen < bypass_header) {
+                    throw std::invalid_argument("truncated data stored by the lossless module");
+                }
+                size_t len;
+                memcpy(&len, src + sizeof(bypass_magic), sizeof(size_t));
+                if (len > srcLen - bypass_header) {
+                    throw std::invalid_argument("truncated data stored by the lossless module");
+                }
+                if (len > dstCap) {
+                    throw std::invalid_argument("dstCap too small for the data stored by the lossless module");
+                }
+                memcpy(dst, src + bypass_header, len);
+                return len;
+            }
+            if (!dctx) {
+                dctx = std::shared_ptr<ZSTD_DCtx>(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            }
+            // data version 3.2.0 may leave bytes after the frame (in the OpenMP blocks), so only the frame is decompressed
+            size_t frameSize = ZSTD_findFrameCompressedSize(src, srcLen);
+            if (ZSTD_isError(frameSize)) {
+                throw std::invalid_argument(std::string("zstd decompression failed: ") + ZSTD_getErrorName(frameSize));
+            }
+            size_t len = ZSTD_decompressDCtx(dctx.get(), dst, dstCap, src, frameSize);
+            if (ZSTD_isError(len)) {
+                throw std::invalid_argument(std::string("zstd decompression failed: ") + ZSTD_getErrorName(len));
+            }
+            return len;
 //            compressedSize = dataLength;
 //            return oriData;
         }
+        
+        // data zstd does not fit in this size is stored as is
+        size_t size_bound(size_t srcLen) const {
+            return srcLen + bypass_header;
+        }
      
      private:
+        // store src as is, behind bypass_magic and srcLen
+        size_t store(const uchar *src, size_t srcLen, uchar *dst, size_t dstCap) {
+            if (dstCap < srcLen + bypass_header) {
+                throw CapacityError("dstCap too small for the data stored by the lossless module");
+            }
+            memcpy(dst, bypass_magic, sizeof(bypass_magic));
+            memcpy(dst + sizeof(bypass_magic), &srcLen, sizeof(size_t));
+            memcpy(dst + bypass_header, src, srcLen);
+            return srcLen + bypass_header;
+        }
+        
+        /**
+         * whether zstd saves more than 1/32 of the data, estimated by compressing sample_blocks blocks
+         * spread evenly over it. Data of a few samples is always compressed, the estimate would not save much time.
+         */
+        bool worth_compressing(const uchar *src, size_t srcLen) {
+            if (srcLen < 4 * sample_blocks * sample_block) {
+                return true;
+            }
+            std::vector<uchar> sample(sample_blocks * sample_block);
+            size_t step = srcLen / sample_blocks;
+            for (size_t i = 0; i < sample_blocks; i++) {
+                memcpy(sample.data() + i * sample_block, src + i * step, sample_block);
+            }
+            if (!cctx) {
+                cctx = std::shared_ptr<ZSTD_CCtx>(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            }
+            std::vector<uchar> cmpSample(ZSTD_compressBound(sample.size()));
+            reset_session();
+            set_parameter(ZSTD_c_compressionLevel, compression_level);
+            set_parameter(ZSTD_c_nbWorkers, 0);
+            size_t cmpSize = ZSTD_compress2(cctx.get(), cmpSample.data(), cmpSample.size(), sample.data(), sample.size());
+            return ZSTD_isError(cmpSize) || cmpSize < sample.size() - sample.size() / 32;
+        }
+        
+        // a compression that failed, e.g. for want of room in dst, leaves its frame open, and zstd takes no parameters until it is dropped
+        void reset_session() {
+            size_t ret = ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_only);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(ret));
+            }
+        }
+        
+        void set_parameter(ZSTD_cParameter param, int value) {
+            size_t ret = ZSTD_CCtx_setParameter(cctx.get(), param, value);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(ret));
+            }
+        }
+        
+        // zstd built without ZSTD_MULTITHREAD rejects any worker, and then compresses in the calling thread
+        static int supported_workers(int workers) {
+            ZSTD_bounds bounds = ZSTD_cParam_getBounds(ZSTD_c_nbWorkers);
+            return ZSTD_isError(bounds.error) ? 0 : std::min(workers, bounds.upperBound);
+        }
+        
+        // not a zstd frame (nor legacy or skippable frame) magic number
+        static constexpr uchar bypass_magic[4] = {'S', 'Z', '3', 'B'};
+        static constexpr size_t bypass_header = sizeof(bypass_magic) + sizeof(size_t);
+        static constexpr size_t sample_block = 16 * 1024, sample_blocks = 8;
+        
         int compression_level = 3;  //default setting of level is 3
+        int nb_workers = 0;
+        uint8_t mode = LOSSLESS_ZSTD;
+        std::shared_ptr<ZSTD_CCtx> cctx;
+        std::shared_ptr<ZSTD_DCtx> dctx;
     };
 }
 #endif //SZ_LOSSLESS_ZSTD_HPP
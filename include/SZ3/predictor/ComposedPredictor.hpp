@@ -88,6 +88,14 @@ namespace SZ3 {
 //            c += selection.size() * sizeof(int);
         }
 
+        size_t size_bound(size_t num_blocks) const {
+            size_t bound = sizeof(size_t) + HuffmanEncoder<int>().size_bound(num_blocks, predictors.size());
+            for (const auto &p: predictors) {
+                bound += p->size_bound(num_blocks);
+            }
+            return bound;
+        }
+
         void load(const uchar *&c, size_t &remaining_length) {
             auto tmp = c;
             for (const auto &p:predictors) {
@@ -68,6 +68,10 @@ namespace SZ3 {
             c += sizeof(uint8_t);
         }
 
+        size_t size_bound(size_t num_blocks) const {
+            return sizeof(uint8_t);
+        }
+
         /*
          * just verifies the ID, increments
          */
@@ -4,6 +4,7 @@
 #include "SZ3/utils/MetaDef.hpp"
 #include "SZ3/encoder/HuffmanEncoder.hpp"
 #include "SZ3/utils/MemoryUtil.hpp"
+#include <stdexcept>
 
 namespace SZMETA {
 
@@ -52,19 +53,24 @@ namespace SZMETA {
 
     template<typename T>
     float *
-    decode_regression_coefficients(const unsigned char *&compressed_pos, size_t reg_count, int block_size, T precision,
-                                   const meta_params &params) {
+    decode_regression_coefficients(const unsigned char *&compressed_pos, size_t &remaining_length, size_t reg_count,
+                                   int block_size, T precision, const meta_params &params) {
         size_t reg_unpredictable_count = 0;
-        size_t remaining_length = RegCoeffNum3d * reg_count;//fake, has no meaning
         SZ3::read(reg_unpredictable_count, compressed_pos, remaining_length);
+        if (reg_unpredictable_count > remaining_length / sizeof(float)) {
+            throw std::invalid_argument("truncated regression coefficients in the compressed data");
+        }
         const float *reg_unpredictable_data_pos = (const float *) compressed_pos;
         compressed_pos += reg_unpredictable_count * sizeof(float);
+        remaining_length -= reg_unpredictable_count * sizeof(float);
 
 //        int *reg_type = Huffman_decode_tree_and_data(2 * RegCoeffCapacity, RegCoeffNum3d * reg_count, compressed_pos);
         SZ3::HuffmanEncoder<int> selector_encoder = SZ3::HuffmanEncoder<int>();
         selector_encoder.load(compressed_pos, remaining_length);
+        const unsigned char *reg_type_pos = compressed_pos;
         auto reg_vector = selector_encoder.decode(compressed_pos, RegCoeffNum3d * reg_count);
         selector_encoder.postprocess_decode();
+        remaining_length -= compressed_pos - reg_type_pos;
         int *reg_type = reg_vector.data();
 
         float *reg_params = (float *) malloc(RegCoeffNum3d * (reg_count + 1) * sizeof(float));
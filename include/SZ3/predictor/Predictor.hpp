@@ -56,6 +56,12 @@ namespace SZ3::concepts {
          */
         virtual void save(uchar *&c) const = 0;
 
+        /**
+         * worst-case size of save(), known before compression
+         * @param num_blocks number of blocks the predictor is applied to
+         */
+        virtual size_t size_bound(size_t num_blocks) const = 0;
+
         /**
          * deserialize the predictor from a buffer
          * @param c start location of the predictor in the buffer
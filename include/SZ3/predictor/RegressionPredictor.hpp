@@ -117,6 +117,14 @@ namespace SZ3 {
             }
         }
 
+        size_t size_bound(size_t num_blocks) const {
+            // unpredictable coefficients are kept by the two quantizers, one T each
+            return sizeof(uint8_t) + sizeof(size_t) + 2 * LinearQuantizer<T>::size_bound(0) +
+                   HuffmanEncoder<int>().size_bound((N + 1) * num_blocks,
+                                                     2 * std::max(quantizer_independent.get_radius(), quantizer_liner.get_radius()),
+                                                     8 * sizeof(T));
+        }
+
         bool predecompress_block(const std::shared_ptr<Range> &range) noexcept {
             for (const auto &dim: range->get_dimensions()) {
                 if (dim <= 1) {
@@ -141,9 +149,10 @@ namespace SZ3 {
                 quantizer_liner.load(c, remaining_length);
                 HuffmanEncoder<int> encoder = HuffmanEncoder<int>();
                 encoder.load(c, remaining_length);
+                const uchar *coeff_pos = c;
                 regression_coeff_quant_inds = encoder.decode(c, coeff_size);
                 encoder.postprocess_decode();
-                remaining_length -= coeff_size * sizeof(int);
+                remaining_length -= c - coeff_pos;
                 std::fill(current_coeffs.begin(), current_coeffs.end(), 0);
                 regression_coeff_index = 0;
             }
@@ -1,8 +1,10 @@
 #ifndef _SZ_INTEGER_QUANTIZER_HPP
 #define _SZ_INTEGER_QUANTIZER_HPP
 
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include "SZ3/def.hpp"
@@ -61,11 +63,12 @@ namespace SZ3 {
         }
 
         /**
-         * For metaLorenzo only, will be removed together with metalorenzo
-         * @param ori
-         * @param pred
-         * @param dest
-         * @return
+         * quantize ori with a prediction value, and write the reconstructed value to dest instead of overwriting ori
+         * used by metaLorenzo and by decompositions that keep the input data unmodified
+         * @param ori original value
+         * @param pred predicted value
+         * @param dest reconstructed value
+         * @return quantization index
          */
         int quantize_and_overwrite(T ori, T pred, T &dest) {
             T diff = ori - pred;
@@ -97,6 +100,48 @@ namespace SZ3 {
             }
         }
 
+        /**
+         * quantize n values at once, as quantize_and_overwrite(ori[i], pred[i], dest[i]) does one by one,
+         * except that the values which may be unpredictable get index 0 (and dest = ori) without being recorded:
+         * the caller passes them to quantize_and_overwrite afterwards, in their order.
+         * The loop has no branches, so that it is vectorized (e.g., 8 floats per AVX2 instruction).
+         * @return number of values with index 0
+         */
+        size_t quantize_batch(const T *ori, const T *pred, T *dest, int *quant, size_t n) const {
+            const double eb = error_bound, eb_reciprocal = error_bound_reciprocal, limit = 2.0 * radius - 1;
+            const int r = radius;
+            int unpred_num = 0;
+#pragma omp simd reduction(+:unpred_num)
+            for (size_t i = 0; i < n; i++) {
+                // no conditional floating-point operations, they would keep the loop from being vectorized
+                T diff = ori[i] - pred[i];
+                int sign = diff < 0 ? -1 : 1;
+                double scaled = std::fabs(diff) * eb_reciprocal;
+                int predictable = scaled < limit;
+                int half_index = ((int) std::min(limit, scaled) + 1) >> 1;
+                int quant_index = 2 * sign * half_index;
+                T decompressed_data = pred[i] + quant_index * eb;
+                predictable &= std::fabs(decompressed_data - ori[i]) <= eb;
+                quant[i] = predictable * (r + sign * half_index);
+                dest[i] = predictable ? decompressed_data : ori[i];
+                unpred_num += 1 - predictable;
+            }
+            return unpred_num;
+        }
+
+        /**
+         * recover n values at once with recover_pred, the ones of index 0 are left
+         * for recover(pred[i], 0) to be called afterwards in their order. The loop is vectorized.
+         */
+        void recover_batch(const T *pred, const int *quant, T *dest, size_t n) const {
+            const double eb = error_bound;
+            const int r = radius;
+#pragma omp simd
+            for (size_t i = 0; i < n; i++) {
+                dest[i] = pred[i] + 2 * (quant[i] - r) * eb;
+            }
+        }
+
         // recover the data using the quantization index
         T recover(T pred, int quant_index) {
             if (quant_index) {
@@ -119,6 +164,31 @@ namespace SZ3 {
             return unpred.size() * sizeof(T);
         }
 
+        /**
+         * quantizer with the same settings and no unpredictable values,
+         * used to quantize or recover part of the data apart (e.g., on another thread)
+         */
+        LinearQuantizer fork() const {
+            return LinearQuantizer(error_bound, radius);
+        }
+
+        // append the unpredictable values [begin, end) of other, to join the parts quantized apart in their order
+        void append_unpred(const LinearQuantizer &other, size_t begin, size_t end) {
+            unpred.insert(unpred.end(), other.unpred.begin() + begin, other.unpred.begin() + end);
+        }
+
+        size_t get_unpred_num() const { return unpred.size(); }
+
+        // number of unpredictable values recovered so far
+        size_t get_unpred_index() const { return index; }
+
+        void set_unpred_index(size_t i) { index = i; }
+
+        // worst-case size of save() with unpred_num unpredictable values
+        static size_t size_bound(size_t unpred_num) {
+            return sizeof(uint8_t) + sizeof(double) + sizeof(int) + sizeof(size_t) + unpred_num * sizeof(T);
+        }
+
         void save(unsigned char *&c) const {
             // std::string serialized(sizeof(uint8_t) + sizeof(T) + sizeof(int),0);
             c[0] = 0b00000010;
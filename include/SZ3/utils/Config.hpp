@@ -5,9 +5,11 @@
 #ifndef SZ_Config_HPP
 #define SZ_Config_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
 #include <vector>
 
 #include "SZ3/def.hpp"
@@ -46,6 +48,12 @@ enum INTERP_ALGO { INTERP_ALGO_LINEAR, INTERP_ALGO_CUBIC };
 constexpr const char *INTERP_ALGO_STR[] = {"INTERP_ALGO_LINEAR", "INTERP_ALGO_CUBIC"};
 constexpr INTERP_ALGO INTERP_ALGO_OPTIONS[] = {INTERP_ALGO_LINEAR, INTERP_ALGO_CUBIC};
 
+enum ENCODER { ENCODER_SKIP, ENCODER_HUFFMAN, ENCODER_ARITHMETIC, ENCODER_RANS };
+constexpr const char *ENCODER_STR[] = {"ENCODER_SKIP", "ENCODER_HUFFMAN", "ENCODER_ARITHMETIC", "ENCODER_RANS"};
+
+enum LOSSLESS { LOSSLESS_BYPASS, LOSSLESS_ZSTD, LOSSLESS_AUTO };
+constexpr const char *LOSSLESS_STR[] = {"LOSSLESS_BYPASS", "LOSSLESS_ZSTD", "LOSSLESS_AUTO"};
+
 template <class T>
 const char *enum2Str(T e) {
     if (std::is_same<T, ALGO>::value) {
@@ -60,6 +68,14 @@ const char *enum2Str(T e) {
     }
 }
 
+// data version 3.2.0, the oldest one still decompressed. It differs from the current one in the Huffman trees
+// (stored as node arrays, with the codes in one piece) and in the OpenMP blocks (cut along the first dimension only).
+constexpr uint32_t SZ3_LEGACY_DATA_VER = 3u << 24 | 2u << 16;
+
+// room for the Config at the head of every stream, fixed since data version 3.2.0 (where it was sizeof(Config) plus
+// the dims vector on 64-bit platforms). Streams of every platform use this size, so it does not change with the members of Config.
+constexpr size_t SZ3_CONFIG_SIZE = 160;
+
 class Config {
    public:
     template <class... Dims>
@@ -126,6 +142,26 @@ class Config {
         l2normErrorBound = cfg.GetReal("GlobalSettings", "L2NormErrorBound", l2normErrorBound);
 
         openmp = cfg.GetBoolean("GlobalSettings", "OpenMP", openmp);
+        ompBlocks = cfg.GetInteger("GlobalSettings", "OpenMPBlocks", ompBlocks);
+        ompInterp = cfg.GetBoolean("GlobalSettings", "OpenMPInterpolation", ompInterp);
+        tileSize = cfg.GetInteger("GlobalSettings", "TileSize", tileSize);
+        progressive = cfg.GetBoolean("GlobalSettings", "Progressive", progressive);
+        auto encoderStr = cfg.Get("GlobalSettings", "Encoder", "");
+        if (encoderStr == ENCODER_STR[ENCODER_HUFFMAN]) {
+            encoder = ENCODER_HUFFMAN;
+        } else if (encoderStr == ENCODER_STR[ENCODER_RANS]) {
+            encoder = ENCODER_RANS;
+        }
+        auto losslessStr = cfg.Get("GlobalSettings", "Lossless", "");
+        if (losslessStr == LOSSLESS_STR[LOSSLESS_BYPASS]) {
+            lossless = LOSSLESS_BYPASS;
+        } else if (losslessStr == LOSSLESS_STR[LOSSLESS_ZSTD]) {
+            lossless = LOSSLESS_ZSTD;
+        } else if (losslessStr == LOSSLESS_STR[LOSSLESS_AUTO]) {
+            lossless = LOSSLESS_AUTO;
+        }
+        zstdLevel = cfg.GetInteger("GlobalSettings", "ZstdLevel", zstdLevel);
+        zstdWorkers = cfg.GetInteger("GlobalSettings", "ZstdWorkers", zstdWorkers);
         lorenzo = cfg.GetBoolean("AlgoSettings", "Lorenzo", lorenzo);
         lorenzo2 = cfg.GetBoolean("AlgoSettings", "Lorenzo2ndOrder", lorenzo2);
         regression = cfg.GetBoolean("AlgoSettings", "Regression", regression);
@@ -144,6 +180,8 @@ class Config {
 
     size_t save(unsigned char *&c) {
         auto c0 = c;
+        // a Config loaded from older data is saved with the data it describes now
+        sz3DataVer = versionInt(SZ3_DATA_VER);
         write(sz3MagicNumber, c);
         write(sz3DataVer, c);
         write(N, c);
@@ -173,8 +211,11 @@ class Config {
         }
 
         uint8_t boolvals = (lorenzo & 1) << 7 | (lorenzo2 & 1) << 6 | (regression & 1) << 5 | (regression2 & 1) << 4 |
-                           (openmp & 1) << 3;
+                           (openmp & 1) << 3 | (tileSize > 0) << 2 | (progressive & 1) << 1;
         write(boolvals, c);
+        if (tileSize > 0) {
+            write(tileSize, c);
+        }
 
         write(dataType, c);
         write(lossless, c);
@@ -188,6 +229,9 @@ class Config {
         write(pred_dim, c);
 
         // printf("%lu\n", c - c0);
+        if (c - c0 > (std::ptrdiff_t) SZ3_CONFIG_SIZE) {
+            throw std::length_error("Config is larger than SZ3_CONFIG_SIZE");
+        }
         return c - c0;
     };
 
@@ -198,7 +242,7 @@ class Config {
             throw std::invalid_argument("magic number mismatch, the input data is not compressed by SZ3");
         }
         read(sz3DataVer, c);
-        if (versionStr(sz3DataVer) != SZ3_DATA_VER) {
+        if (versionStr(sz3DataVer) != SZ3_DATA_VER && sz3DataVer != SZ3_LEGACY_DATA_VER) {
             std::stringstream ss;
             printf("program v%s , program-data %s , input data v%s\n", SZ3_VER, SZ3_DATA_VER,
                    versionStr(sz3DataVer).data());
@@ -240,6 +284,11 @@ class Config {
         regression = (boolvals >> 5) & 1;
         regression2 = (boolvals >> 4) & 1;
         openmp = (boolvals >> 3) & 1;
+        tileSize = 0;
+        if ((boolvals >> 2) & 1) {
+            read(tileSize, c);
+        }
+        progressive = (boolvals >> 1) & 1;
 
         read(dataType, c);
         read(lossless, c);
@@ -283,9 +332,15 @@ class Config {
         printf("Regression = %d\n", regression);
         printf("Regression2ndOrder = %d\n", regression2);
         printf("OpenMP = %d\n", openmp);
+        printf("OpenMPBlocks = %zu\n", ompBlocks);
+        printf("OpenMPInterpolation = %d\n", ompInterp);
+        printf("TileSize = %zu\n", tileSize);
+        printf("Progressive = %d\n", progressive);
         printf("DataType = %d\n", dataType);
         printf("Lossless = %d\n", lossless);
         printf("Encoder = %d\n", encoder);
+        printf("ZstdLevel = %d\n", zstdLevel);
+        printf("ZstdWorkers = %d\n", zstdWorkers);
         printf("InterpolationAlgo = %s\n", enum2Str((INTERP_ALGO)interpAlgo));
         printf("InterpolationDirection = %d\n", interpDirection);
         printf("QuantizationBinTotal = %d\n", quantbinCnt);
@@ -295,8 +350,12 @@ class Config {
         printf("===================== End SZ3 Configuration =====================\n");
     }
 
+    // whether the data is in the format of SZ3_LEGACY_DATA_VER
+    bool legacy_format() const { return sz3DataVer == SZ3_LEGACY_DATA_VER; }
+
+    // the compressed data starts this many bytes after the Config in every stream (see SZ3_CONFIG_SIZE)
     static size_t size_est() {
-        return sizeof(Config) + sizeof(size_t) * 5;  // sizeof(size_t) * 5 is for dims vector
+        return SZ3_CONFIG_SIZE;
     }
 
     uint32_t sz3MagicNumber = SZ3_MAGIC_NUMBER;
@@ -315,9 +374,15 @@ class Config {
     bool regression = true;
     bool regression2 = false;
     bool openmp = false;
+    size_t ompBlocks = 0;         // number of blocks compressed in parallel with openmp, 0-> one per thread; not stored in the data
+    bool ompInterp = false;       // interpolation levels run on all openmp threads, same output as serial; not stored in the data
+    size_t tileSize = 0;          // 0-> not tiled; otherwise compressed in independent tiles of tileSize along each dimension
+    bool progressive = false;     // interpolation levels stored apart, so coarse levels can be decompressed alone
     uint8_t dataType = SZ_FLOAT;  // dataType is only used in HDF5 filter
-    uint8_t lossless = 1;         // 0-> skip lossless(use lossless_bypass); 1-> zstd
-    uint8_t encoder = 1;          // 0-> skip encoder; 1->HuffmanEncoder; 2->ArithmeticEncoder
+    uint8_t lossless = LOSSLESS_ZSTD; // 0-> stored as is; 1-> zstd; 2-> zstd or as is, chosen per stream (see Lossless_zstd)
+    uint8_t encoder = ENCODER_HUFFMAN; // 0-> skip encoder; 1->HuffmanEncoder; 2->ArithmeticEncoder; 3->RansEncoder (see with_encoder)
+    int zstdLevel = 3;            // compression level of zstd; not stored in the data
+    int zstdWorkers = 0;          // threads zstd compresses with (ZSTD_c_nbWorkers), 0-> the calling thread; not stored in the data
     uint8_t interpAlgo = INTERP_ALGO_CUBIC;
     uint8_t interpDirection = 0;
     int quantbinCnt = 65536;
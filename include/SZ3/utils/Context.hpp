@@ -0,0 +1,49 @@
+#ifndef SZ3_CONTEXT_HPP
+#define SZ3_CONTEXT_HPP
+
+#include "SZ3/encoder/HuffmanEncoder.hpp"
+#include "SZ3/encoder/RansEncoder.hpp"
+#include "SZ3/lossless/Lossless_zstd.hpp"
+#include "SZ3/utils/Config.hpp"
+#include "SZ3/def.hpp"
+#include <vector>
+
+namespace SZ3 {
+    /**
+     * Context keeps the resources that are costly to set up and reuses them across SZ_compress / SZ_decompress calls:
+     * the zstd compression and decompression contexts, the Huffman tree pool and the scratch buffer of the compressors.
+     * Worth it when compressing many small arrays (e.g., HDF5 chunks), where the setup dominates the run time.
+     *
+     * A context serves one call at a time, use one context per thread.
+     * The OpenMP path keeps its own per-thread resources and does not use the context.
+     *
+     * Example:
+     * SZ3::Context ctx;
+     * for (auto &chunk: chunks) {
+     *     cmpSize = SZ_compress(conf, chunk.data(), cmpData, cmpCap, ctx);
+     * }
+     */
+    class Context {
+    public:
+        // copies of the encoder and lossless modules share the pools of these ones
+        HuffmanEncoder<int> encoder;
+        Lossless_zstd lossless;
+
+        // payload handed to the lossless stage
+        std::vector<uchar> buffer;
+    };
+
+    /**
+     * call func with the encoder of the quantization indices selected by conf.encoder:
+     * a RansEncoder for ENCODER_RANS, huffman (e.g., the encoder of a context) otherwise
+     * @return result of func
+     */
+    template<class Func>
+    auto with_encoder(const Config &conf, const HuffmanEncoder<int> &huffman, Func func) -> decltype(func(huffman)) {
+        if (conf.encoder == ENCODER_RANS) {
+            return func(RansEncoder<int>());
+        }
+        return func(huffman);
+    }
+}
+#endif
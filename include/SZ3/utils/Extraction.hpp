@@ -5,6 +5,8 @@
 #ifndef SZ_EXTRACTION_HPP
 #define SZ_EXTRACTION_HPP
 
+#include "SZ3/utils/Layout.hpp"
+
 namespace SZ3 {
 
     template<uint N>
@@ -19,8 +21,12 @@ namespace SZ3 {
 
     template<class T, uint N>
     inline typename std::enable_if<N == 4, std::vector<T>>::type
-    sampling(T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block) {
+    sampling(const T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block,
+             std::vector<size_t> strides = {}) {
         assert(dims.size() == N);
+        if (strides.empty()) {
+            strides = contiguous_strides(dims);
+        }
         assert(sample_dims.size() == N);
         Timer timer(true);
         size_t num = std::accumulate(dims.begin(), dims.end(), (size_t) 1, std::multiplies<size_t>());
@@ -62,10 +68,10 @@ namespace SZ3 {
                                         dj = j < sampling_block ? j + sampling_block : dmin - 3 * sampling_block + j;
                                         dk = k < sampling_block ? k + sampling_block : dmin - 3 * sampling_block + k;
                                         dt = t < sampling_block ? t + sampling_block : dmin - 3 * sampling_block + t;
-                                        size_t idx = (bi * dmin + di) * dims[1] * dims[2] * dims[3]
-                                                     + (bj * dmin + dj) * dims[2] * dims[3]
-                                                     + (bk * dmin + dk) * dims[3]
-                                                     + bt * dmin + dt;
+                                        size_t idx = (bi * dmin + di) * strides[0]
+                                                     + (bj * dmin + dj) * strides[1]
+                                                     + (bk * dmin + dk) * strides[2]
+                                                     + (bt * dmin + dt) * strides[3];
                                         sampling_data[(bi * 2 * sampling_block + i) * sample_dims[1] * sample_dims[2] * sample_dims[3]
                                                       + (bj * 2 * sampling_block + j) * sample_dims[1] * sample_dims[2]
                                                       + (bk * 2 * sampling_block + k) * sample_dims[2]
@@ -88,8 +94,12 @@ namespace SZ3 {
 
     template<class T, uint N>
     inline typename std::enable_if<N == 3, std::vector<T>>::type
-    sampling(T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block) {
+    sampling(const T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block,
+             std::vector<size_t> strides = {}) {
         assert(dims.size() == N);
+        if (strides.empty()) {
+            strides = contiguous_strides(dims);
+        }
         assert(sample_dims.size() == N);
         size_t num = std::accumulate(dims.begin(), dims.end(), (size_t) 1, std::multiplies<size_t>());
 
@@ -125,8 +135,8 @@ namespace SZ3 {
                                 di = i < sampling_block ? i + sampling_block : dmin - 3 * sampling_block + i;
                                 dj = j < sampling_block ? j + sampling_block : dmin - 3 * sampling_block + j;
                                 dk = k < sampling_block ? k + sampling_block : dmin - 3 * sampling_block + k;
-                                auto d = data[(bi * dmin + di) * dims[1] * dims[2] + (bj * dmin + dj) * dims[2] +
-                                              bk * dmin + dk];
+                                auto d = data[(bi * dmin + di) * strides[0] + (bj * dmin + dj) * strides[1] +
+                                              (bk * dmin + dk) * strides[2]];
                                 sampling_data[(bi * 2 * sampling_block + i) * sample_dims[1] * sample_dims[2]
                                               + (bj * 2 * sampling_block + j) * sample_dims[2]
                                               + bk * 2 * sampling_block + k] = d;
@@ -144,8 +154,12 @@ namespace SZ3 {
 
     template<class T, uint N>
     inline typename std::enable_if<N == 2, std::vector<T>>::type
-    sampling(T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block) {
+    sampling(const T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block,
+             std::vector<size_t> strides = {}) {
         assert(dims.size() == N);
+        if (strides.empty()) {
+            strides = contiguous_strides(dims);
+        }
         assert(sample_dims.size() == N);
         Timer timer(true);
         size_t num = std::accumulate(dims.begin(), dims.end(), (size_t) 1, std::multiplies<size_t>());
@@ -177,7 +191,7 @@ namespace SZ3 {
                     for (size_t j = 0; j < 2 * sampling_block; j++) {
                         di = i < sampling_block ? i + sampling_block : dmin - 3 * sampling_block + i;
                         dj = j < sampling_block ? j + sampling_block : dmin - 3 * sampling_block + j;
-                        auto d = data[(bi * dmin + di) * dims[1] + bj * dmin + dj];
+                        auto d = data[(bi * dmin + di) * strides[0] + (bj * dmin + dj) * strides[1]];
                         sampling_data[(bi * 2 * sampling_block + i) * sample_dims[1]
                                       + bj * 2 * sampling_block + j] = d;
                     }
@@ -192,8 +206,12 @@ namespace SZ3 {
 
     template<class T, uint N>
     inline typename std::enable_if<N == 1, std::vector<T>>::type
-    sampling(T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block) {
+    sampling(const T *data, std::vector<size_t> dims, size_t &sample_num, std::vector<size_t> &sample_dims, size_t &sampling_block,
+             std::vector<size_t> strides = {}) {
         assert(dims.size() == N);
+        if (strides.empty()) {
+            strides = contiguous_strides(dims);
+        }
         assert(sample_dims.size() == N);
         Timer timer(true);
         size_t num = std::accumulate(dims.begin(), dims.end(), (size_t) 1, std::multiplies<size_t>());
@@ -220,7 +238,7 @@ namespace SZ3 {
         for (size_t bi = 0; bi < b0; bi++) {
             for (size_t i = 0; i < 2 * sampling_block; i++) {
                 di = i < sampling_block ? i + sampling_block : dmin - 3 * sampling_block + i;
-                auto d = data[bi * dmin + di];
+                auto d = data[(bi * dmin + di) * strides[0]];
                 sampling_data[bi * 2 * sampling_block + i] = d;
             }
         }
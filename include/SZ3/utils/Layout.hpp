@@ -0,0 +1,120 @@
+#ifndef SZ3_LAYOUT_HPP
+#define SZ3_LAYOUT_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace SZ3 {
+    /**
+     * The layout of an array in memory is given by the stride (in elements) of every dimension:
+     * element (i0, i1, ...) of an array of shape dims is at i0 * strides[0] + i1 * strides[1] + ...
+     * e.g., the 100 x 200 interior of a field with one ghost cell on each side: strides = {202, 1}, from the first interior point;
+     * the 2nd component of a 100 x 200 array of 3-component structs: strides = {600, 3}, from the 2nd component of the first struct.
+     * An empty strides vector stands for the contiguous row-major layout.
+     */
+    inline std::vector<size_t> contiguous_strides(const std::vector<size_t> &dims) {
+        std::vector<size_t> strides(dims.size());
+        size_t stride = 1;
+        for (size_t d = dims.size(); d-- > 0;) {
+            strides[d] = stride;
+            stride *= dims[d];
+        }
+        return strides;
+    }
+
+    inline bool is_contiguous(const std::vector<size_t> &dims, const std::vector<size_t> &strides) {
+        return strides.empty() || strides == contiguous_strides(dims);
+    }
+
+    /**
+     * copy a box of the given size between two strided arrays
+     * @param src source array with srcStrides, the box starts at srcStart
+     * @param dst destination array with dstStrides, the box starts at dstStart
+     */
+    template<class T>
+    void copy_box(const T *src, const std::vector<size_t> &srcStrides, const std::vector<size_t> &srcStart,
+                  T *dst, const std::vector<size_t> &dstStrides, const std::vector<size_t> &dstStart,
+                  const std::vector<size_t> &size) {
+        size_t N = size.size();
+        size_t rows = 1;
+        for (size_t d = 0; d + 1 < N; d++) {
+            rows *= size[d];
+        }
+        std::vector<size_t> idx(N, 0);
+        for (size_t r = 0; r < rows; r++) {
+            size_t srcOffset = 0, dstOffset = 0;
+            for (size_t d = 0; d < N; d++) {
+                srcOffset += (srcStart[d] + idx[d]) * srcStrides[d];
+                dstOffset += (dstStart[d] + idx[d]) * dstStrides[d];
+            }
+            if (srcStrides[N - 1] == 1 && dstStrides[N - 1] == 1) {
+                memcpy(dst + dstOffset, src + srcOffset, size[N - 1] * sizeof(T));
+            } else {
+                for (size_t i = 0; i < size[N - 1]; i++) {
+                    dst[dstOffset + i * dstStrides[N - 1]] = src[srcOffset + i * srcStrides[N - 1]];
+                }
+            }
+            for (size_t d = N - 1; d-- > 0;) {
+                if (++idx[d] < size[d]) {
+                    break;
+                }
+                idx[d] = 0;
+            }
+        }
+    }
+
+    // copy a strided array of shape dims to a contiguous one
+    template<class T>
+    void pack(const T *src, const std::vector<size_t> &strides, T *dst, const std::vector<size_t> &dims) {
+        std::vector<size_t> start(dims.size(), 0);
+        copy_box(src, strides, start, dst, contiguous_strides(dims), start, dims);
+    }
+
+    // copy a contiguous array of shape dims to a strided one
+    template<class T>
+    void unpack(const T *src, T *dst, const std::vector<size_t> &strides, const std::vector<size_t> &dims) {
+        std::vector<size_t> start(dims.size(), 0);
+        copy_box(src, contiguous_strides(dims), start, dst, strides, start, dims);
+    }
+
+    // smallest and largest value of a strided array of shape dims
+    template<class T>
+    std::pair<T, T> data_minmax(const T *data, const std::vector<size_t> &dims, const std::vector<size_t> &strides) {
+        size_t N = dims.size();
+        size_t rows = 1;
+        for (size_t d = 0; d + 1 < N; d++) {
+            rows *= dims[d];
+        }
+        T max = data[0];
+        T min = data[0];
+        std::vector<size_t> idx(N, 0);
+        for (size_t r = 0; r < rows; r++) {
+            size_t offset = 0;
+            for (size_t d = 0; d + 1 < N; d++) {
+                offset += idx[d] * strides[d];
+            }
+            for (size_t i = 0; i < dims[N - 1]; i++) {
+                T v = data[offset + i * strides[N - 1]];
+                if (max < v) max = v;
+                if (min > v) min = v;
+            }
+            for (size_t d = N - 1; d-- > 0;) {
+                if (++idx[d] < dims[d]) {
+                    break;
+                }
+                idx[d] = 0;
+            }
+        }
+        return {min, max};
+    }
+
+    // value range of a strided array of shape dims
+    template<class T>
+    T data_range(const T *data, const std::vector<size_t> &dims, const std::vector<size_t> &strides) {
+        auto minmax = data_minmax(data, dims, strides);
+        return minmax.second - minmax.first;
+    }
+}
+#endif
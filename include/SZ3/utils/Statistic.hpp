@@ -6,6 +6,7 @@
 #define SZ_STATISTIC_HPP
 
 #include "Config.hpp"
+#include "Layout.hpp"
 
 namespace SZ3 {
     template<class T>
@@ -30,24 +31,28 @@ namespace SZ3 {
         return value_range * v3;
     }
 
-    template<class T>
-    void calAbsErrorBound(Config &conf, const T *data, T range = 0) {
+    /**
+     * turn the error bound of conf into an absolute one
+     * @param value_range returns the value range of the data, only called by the modes relative to it
+     */
+    template<class Func>
+    void calAbsErrorBoundFromRange(Config &conf, Func value_range) {
         if (conf.errorBoundMode != EB_ABS) {
             if (conf.errorBoundMode == EB_REL) {
                 conf.errorBoundMode = EB_ABS;
-                conf.absErrorBound = conf.relErrorBound * ((range > 0) ? range : data_range(data, conf.num));
+                conf.absErrorBound = conf.relErrorBound * value_range();
             } else if (conf.errorBoundMode == EB_PSNR) {
                 conf.errorBoundMode = EB_ABS;
-                conf.absErrorBound = computeABSErrBoundFromPSNR(conf.psnrErrorBound, 0.99, ((range > 0) ? range : data_range(data, conf.num)));
+                conf.absErrorBound = computeABSErrBoundFromPSNR(conf.psnrErrorBound, 0.99, value_range());
             } else if (conf.errorBoundMode == EB_L2NORM) {
                 conf.errorBoundMode = EB_ABS;
                 conf.absErrorBound = sqrt(3.0 / conf.num) * conf.l2normErrorBound;
             } else if (conf.errorBoundMode == EB_ABS_AND_REL) {
                 conf.errorBoundMode = EB_ABS;
-                conf.absErrorBound = std::min(conf.absErrorBound, conf.relErrorBound * ((range > 0) ? range : data_range(data, conf.num)));
+                conf.absErrorBound = std::min(conf.absErrorBound, conf.relErrorBound * value_range());
             } else if (conf.errorBoundMode == EB_ABS_OR_REL) {
                 conf.errorBoundMode = EB_ABS;
-                conf.absErrorBound = std::max(conf.absErrorBound, conf.relErrorBound * ((range > 0) ? range : data_range(data, conf.num)));
+                conf.absErrorBound = std::max(conf.absErrorBound, conf.relErrorBound * value_range());
             } else {
                 printf("Error, error bound mode not supported\n");
                 exit(0);
@@ -55,6 +60,19 @@ namespace SZ3 {
         }
     }
 
+    template<class T>
+    void calAbsErrorBound(Config &conf, const T *data, T range = 0) {
+        calAbsErrorBoundFromRange(conf, [&]() -> T { return (range > 0) ? range : data_range(data, conf.num); });
+    }
+
+    // same as above for data with the given strides (contiguous if empty), see Layout.hpp
+    template<class T>
+    void calAbsErrorBound(Config &conf, const T *data, const std::vector<size_t> &strides) {
+        calAbsErrorBoundFromRange(conf, [&]() -> T {
+            return strides.empty() ? data_range(data, conf.num) : data_range(data, conf.dims, strides);
+        });
+    }
+
     template<typename Type>
     double autocorrelation1DLag1(const Type *data, size_t numOfElem, Type avg) {
         double cov = 0;
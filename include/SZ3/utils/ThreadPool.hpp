@@ -0,0 +1,92 @@
+#ifndef SZ3_THREADPOOL_HPP
+#define SZ3_THREADPOOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace SZ3 {
+    /**
+     * Fixed-size pool of worker threads running tasks in submission order.
+     * shared() is the pool used by the asynchronous API, created on first use with one thread per hardware thread.
+     * Pending tasks still run when the pool is destroyed.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t num_threads) {
+            num_threads = std::max<size_t>(num_threads, 1);
+            for (size_t i = 0; i < num_threads; i++) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+            }
+            cv.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        static ThreadPool &shared() {
+            static ThreadPool pool(std::thread::hardware_concurrency());
+            return pool;
+        }
+
+        /**
+         * run func on a worker thread
+         * @return future of the result of func, it also carries the exception thrown by func
+         */
+        template<class Func>
+        auto submit(Func func) -> std::future<decltype(func())> {
+            using R = decltype(func());
+            auto task = std::make_shared<std::packaged_task<R()>>(std::move(func));
+            auto result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace([task] { (*task)(); });
+            }
+            cv.notify_one();
+            return result;
+        }
+
+        size_t size() const { return workers.size(); }
+
+    private:
+        void work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [this] { return stopped || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopped = false;
+    };
+}
+#endif
@@ -148,7 +148,7 @@ void process_data(SZ3::Config &conf, void **buf, size_t *buf_size, size_t nbytes
         *buf = processedData;
         *buf_size = conf.num * sizeof(T);
     } else {
-        size_t cmpCap = sizeof(T) * conf.num;
+        size_t cmpCap = SZ_compress_bound<T>(conf);
         char *cmpData = (char *) malloc(cmpCap);
         *buf_size = SZ_compress(conf, (T *) *buf, cmpData, cmpCap);
         free(*buf);
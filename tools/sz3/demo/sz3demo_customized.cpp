@@ -32,6 +32,10 @@ public:
         read(num, c, remaining_length);
     }
 
+    size_t size_bound(const Config &conf) {
+        return sizeof(num);
+    }
+
 private:
     size_t num;
 };
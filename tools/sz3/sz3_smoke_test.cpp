@@ -3,10 +3,637 @@
 //
 
 #include <SZ3/api/sz.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <string>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-int main(int argc, char **argv) {
+// directory of testfloat_8_8_128.dat and of the data version 3.2.0 streams compressed from it
+#ifndef SZ3_SMOKE_TEST_DIR
+#define SZ3_SMOKE_TEST_DIR "."
+#endif
+
+double max_error(const float *a, const float *b, size_t num) {
+    double max_err = 0.0;
+    for (size_t i = 0; i < num; i++) {
+        if (fabs(a[i] - b[i]) > max_err) {
+            max_err = fabs(a[i] - b[i]);
+        }
+    }
+    return max_err;
+}
+
+// the field of main on a smaller grid
+std::vector<float> smooth_field(size_t n0, size_t n1, size_t n2) {
+    std::vector<float> data(n0 * n1 * n2);
+    for (size_t i = 0; i < n0; ++i) {
+        for (size_t j = 0; j < n1; ++j) {
+            for (size_t k = 0; k < n2; ++k) {
+                double x = static_cast<double>(i) - static_cast<double>(n0) / 2.0;
+                double y = static_cast<double>(j) - static_cast<double>(n1) / 2.0;
+                double z = static_cast<double>(k) - static_cast<double>(n2) / 2.0;
+                data[(i * n1 + j) * n2 + k] = static_cast<float>(.0001 * y * sin(y) + .0005 * cos(pow(x, 2) + x) + z);
+            }
+        }
+    }
+    return data;
+}
+
+// compress and decompress data with conf, and check the absolute error bound
+bool round_trip(const char *name, SZ3::Config conf, const std::vector<float> &input_data) {
+    std::vector<float> input_data_copy(input_data);
+    std::vector<float> dec_data(conf.num);
+    size_t cmpSize;
+    char *cmpData = SZ_compress(conf, input_data_copy.data(), cmpSize);
+    SZ3::Config dec_conf;
+    auto dec_data_p = dec_data.data();
+    SZ_decompress(dec_conf, cmpData, cmpSize, dec_data_p);
+    delete[] cmpData;
+
+    double max_err = max_error(dec_data.data(), input_data.data(), conf.num);
+    bool passed = max_err <= conf.absErrorBound;
+    printf("%-16s ratio %8.2f max error %g %s\n", name, conf.num * sizeof(float) * 1.0 / cmpSize, max_err,
+           passed ? "passed" : "failed");
+    return passed;
+}
+
+// decompress a stream written by SZ3 with data version 3.2.0 and check it against the original data
+bool legacy_decode(const std::string &dir, const char *name, const std::vector<float> &original, double eb) {
+    std::ifstream file(dir + "/testfloat_8_8_128_v3.2.0_" + name + ".sz", std::ios::binary);
+    std::vector<char> cmpData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (cmpData.empty()) {
+        printf("legacy %-14s missing in %s failed\n", name, dir.c_str());
+        return false;
+    }
+    SZ3::Config conf;
+    float *dec_data = nullptr;
+    SZ_decompress(conf, cmpData.data(), cmpData.size(), dec_data);
+    double max_err = max_error(dec_data, original.data(), conf.num);
+    delete[] dec_data;
+
+    bool passed = conf.num <= original.size() && max_err <= eb;
+    printf("legacy %-14s max error %g %s\n", name, max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// push rows unevenly into a StreamCompressor and its frames in odd-sized chunks into a StreamDecompressor
+bool test_stream() {
+    size_t nt = 37, ny = 20, nx = 30, windowRows = 8;
+    auto data = smooth_field(nt, ny, nx);
+    SZ3::Config conf(nt, ny, nx);
+    conf.absErrorBound = 1E-3;
+
+    std::vector<char> cmpData;
+    SZ3::StreamCompressor<float, 3> compressor(conf, windowRows, [&](const char *frame, size_t frameSize) {
+        cmpData.insert(cmpData.end(), frame, frame + frameSize);
+    });
+    for (size_t t = 0, rows = 1; t < nt; t += rows, rows = rows % 5 + 1) {
+        rows = std::min(rows, nt - t);
+        compressor.push(data.data() + t * ny * nx, rows);
+    }
+    compressor.finish();
+
+    std::vector<float> dec_data;
+    SZ3::StreamDecompressor<float, 3> decompressor([&](const float *rows, size_t nRows) {
+        dec_data.insert(dec_data.end(), rows, rows + nRows * ny * nx);
+    });
+    for (size_t pos = 0, chunk = 777; pos < cmpData.size(); pos += chunk) {
+        decompressor.push(cmpData.data() + pos, std::min(chunk, cmpData.size() - pos));
+    }
+    decompressor.finish();
+
+    // the first frame after its size prefix is a standalone SZ3 stream of windowRows rows
+    size_t streamSize;
+    memcpy(&streamSize, cmpData.data(), sizeof(size_t));
+    SZ3::Config frame_conf;
+    float *frame_data = nullptr;
+    SZ_decompress(frame_conf, cmpData.data() + sizeof(size_t), streamSize, frame_data);
+    delete[] frame_data;
+
+    size_t frames = (nt + windowRows - 1) / windowRows;
+    bool passed = compressor.get_frame_count() == frames && decompressor.get_frame_count() == frames &&
+                  compressor.get_compressed_size() == cmpData.size() && decompressor.get_rows() == nt &&
+                  dec_data.size() == data.size() && frame_conf.dims[0] == windowRows;
+    double max_err = passed ? max_error(dec_data.data(), data.data(), data.size()) : 0;
+    passed = passed && max_err <= conf.absErrorBound;
+    printf("%-16s frames %zu max error %g %s\n", "stream", decompressor.get_frame_count(), max_err,
+           passed ? "passed" : "failed");
+    return passed;
+}
+
+// noise at a tiny error bound is larger as lossy data than as is, and is stored as is in SZ_compress_bound,
+// a buffer below the stored size throws SZ3::CapacityError
+bool test_capacity() {
+    std::vector<float> data(40 * 50 * 60);
+    uint32_t seed = 3;
+    for (auto &v: data) {
+        seed = seed * 1664525u + 1013904223u;
+        v = ldexpf(static_cast<float>(seed >> 8) / (1u << 24), static_cast<int>(seed % 41) - 20);
+    }
+    SZ3::Config conf(40, 50, 60);
+    conf.absErrorBound = 1E-30;
+    size_t cmpCap = SZ_compress_bound<float>(conf);
+    std::vector<char> cmpData(cmpCap);
+    size_t cmpSize = SZ_compress(conf, data.data(), cmpData.data(), cmpCap);
+    SZ3::Config dec_conf;
+    std::vector<float> dec_data(data.size());
+    SZ_decompress(dec_conf, cmpData.data(), cmpSize, dec_data.data(), {});
+    bool passed = cmpSize <= cmpCap && memcmp(dec_data.data(), data.data(), data.size() * sizeof(float)) == 0;
+
+    bool thrown = false;
+    try {
+        SZ_compress(conf, data.data(), cmpData.data(), cmpCap / 2);
+    } catch (SZ3::CapacityError &) {
+        thrown = true;
+    }
+    passed = passed && thrown;
+    printf("%-16s size %zu of %zu %s\n", "capacity", cmpSize, cmpCap, passed ? "passed" : "failed");
+    return passed;
+}
+
+// compress arrays of different ranges in one batch, each one keeps the relative error bound of its own range
+bool test_batch() {
+    size_t count = 9;
+    auto field = smooth_field(20, 30, 40);
+    std::vector<std::vector<float>> arrays(count, field);
+    std::vector<const float *> inputs;
+    for (size_t i = 0; i < count; i++) {
+        for (auto &v: arrays[i]) {
+            v *= static_cast<float>(i + 1);
+        }
+        inputs.push_back(arrays[i].data());
+    }
+    SZ3::Config conf(20, 30, 40);
+    conf.errorBoundMode = SZ3::EB_REL;
+    conf.relErrorBound = 1E-3;
+
+    bool passed = true;
+    for (bool shareCodebook: {false, true}) {
+        size_t cmpSize;
+        char *cmpData = SZ_compress_batch(conf, inputs, cmpSize, shareCodebook);
+        SZ3::Config dec_conf;
+        std::vector<float *> dec_data;
+        SZ_decompress_batch(dec_conf, cmpData, cmpSize, dec_data);
+        passed = passed && dec_data.size() == count;
+        for (size_t i = 0; i < dec_data.size(); i++) {
+            auto range = std::minmax_element(arrays[i].begin(), arrays[i].end());
+            double eb = conf.relErrorBound * (*range.second - *range.first);
+            passed = passed && max_error(dec_data[i], arrays[i].data(), conf.num) <= eb;
+            delete[] dec_data[i];
+        }
+        dec_data.clear();
+
+        if (!shareCodebook) {
+            // break the lossless frame of the first array, the thread decoding it throws
+            size_t headerLen = sizeof(size_t) + sizeof(SZ3::uchar) + conf.size_est() + count * (sizeof(double) + sizeof(size_t));
+            cmpData[headerLen] ^= 0x5A;
+            bool thrown = false;
+            try {
+                SZ_decompress_batch(dec_conf, cmpData, cmpSize, dec_data);
+            } catch (std::exception &) {
+                thrown = true;
+            }
+            for (auto p: dec_data) {
+                delete[] p;
+            }
+            passed = passed && thrown;
+        }
+        delete[] cmpData;
+    }
+
+    printf("%-16s arrays %zu %s\n", "batch", count, passed ? "passed" : "failed");
+    return passed;
+}
+
+// boxes decoded from the tiles they overlap equal the same boxes of the full decompression
+bool test_tiles() {
+    size_t n0 = 50, n1 = 60, n2 = 70;
+    auto data = smooth_field(n0, n1, n2);
+    SZ3::Config conf(n0, n1, n2);
+    conf.absErrorBound = 1E-3;
+    conf.tileSize = 32;
+    size_t cmpSize;
+    char *cmpData = SZ_compress(conf, data.data(), cmpSize);
+    SZ3::Config dec_conf;
+    std::vector<float> dec_data(data.size());
+    SZ_decompress(dec_conf, cmpData, cmpSize, dec_data.data(), {});
+    double max_err = max_error(dec_data.data(), data.data(), data.size());
+    bool passed = max_err <= conf.absErrorBound;
+
+    // within one tile, across tile borders from a non-zero lo, into the smaller tiles at the end, and the whole data
+    std::vector<std::pair<std::vector<size_t>, std::vector<size_t>>> boxes = {
+            {{1, 2, 3},   {9, 10, 11}},
+            {{5, 31, 20}, {40, 45, 70}},
+            {{33, 59, 63}, {50, 60, 70}},
+            {{0, 0, 0},   {n0, n1, n2}}};
+    for (auto &box: boxes) {
+        auto &lo = box.first, &hi = box.second;
+        std::vector<float> region((hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]));
+        float *region_p = region.data();
+        SZ_decompress_region(dec_conf, cmpData, cmpSize, lo, hi, region_p);
+        size_t r = 0;
+        for (size_t i = lo[0]; i < hi[0]; i++) {
+            for (size_t j = lo[1]; j < hi[1]; j++) {
+                for (size_t k = lo[2]; k < hi[2]; k++) {
+                    passed = passed && region[r++] == dec_data[(i * n1 + j) * n2 + k];
+                }
+            }
+        }
+    }
+
+    // the tile sizes point past the end of a truncated stream
+    bool thrown = false;
+    try {
+        SZ_decompress(dec_conf, cmpData, cmpSize / 2, dec_data.data(), {});
+    } catch (std::invalid_argument &) {
+        thrown = true;
+    }
+    passed = passed && thrown;
+    delete[] cmpData;
+    printf("%-16s regions %zu max error %g %s\n", "tiles", boxes.size(), max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// every level of progressive data has the shape of level_dims, and its points keep the error bound
+bool test_levels() {
+    size_t n0 = 33, n1 = 40, n2 = 50;
+    auto data = smooth_field(n0, n1, n2);
+    SZ3::Config conf(n0, n1, n2);
+    conf.cmprAlgo = SZ3::ALGO_INTERP;
+    conf.absErrorBound = 1E-3;
+    conf.progressive = true;
+    size_t cmpSize;
+    char *cmpData = SZ_compress(conf, data.data(), cmpSize);
+
+    bool passed = true;
+    double max_err = 0;
+    uint levels = 7; // up to a single point along every dimension
+    for (uint level = 0; level < levels; level++) {
+        SZ3::Config dec_conf;
+        auto dims = SZ3::level_dims({n0, n1, n2}, level);
+        std::vector<float> dec_data(dims[0] * dims[1] * dims[2]);
+        float *dec_data_p = dec_data.data();
+        SZ_decompress_level(dec_conf, cmpData, cmpSize, level, dec_data_p);
+        passed = passed && dims[0] == ((n0 - 1) >> level) + 1;
+        for (size_t i = 0; i < dims[0]; i++) {
+            for (size_t j = 0; j < dims[1]; j++) {
+                for (size_t k = 0; k < dims[2]; k++) {
+                    float ori = data[((i << level) * n1 + (j << level)) * n2 + (k << level)];
+                    max_err = std::max(max_err, (double) fabs(dec_data[(i * dims[1] + j) * dims[2] + k] - ori));
+                }
+            }
+        }
+    }
+    passed = passed && max_err <= conf.absErrorBound;
+
+    // the level sizes point past the end of a truncated stream
+    bool thrown = false;
+    try {
+        SZ3::Config dec_conf;
+        std::vector<float> dec_data(data.size());
+        float *dec_data_p = dec_data.data();
+        SZ_decompress_level(dec_conf, cmpData, cmpSize / 2, 2, dec_data_p);
+    } catch (std::invalid_argument &) {
+        thrown = true;
+    }
+    passed = passed && thrown;
+    delete[] cmpData;
+    printf("%-16s levels %u max error %g %s\n", "levels", levels, max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// several compressions in flight at once on the shared pool, with a sink or into buffers of the caller
+bool test_async() {
+    size_t steps = 6;
+    SZ3::Config conf(20, 30, 40);
+    conf.absErrorBound = 1E-3;
+    std::vector<std::vector<float>> fields(steps, smooth_field(20, 30, 40));
+    for (size_t s = 0; s < steps; s++) {
+        for (auto &v: fields[s]) {
+            v += static_cast<float>(s);
+        }
+    }
+
+    size_t cmpCap = SZ_compress_bound<float>(conf);
+    std::vector<std::vector<char>> cmpData(steps);
+    std::vector<std::future<size_t>> pending;
+    std::atomic<size_t> consumed(0);
+    for (size_t s = 0; s < steps; s++) {
+        if (s % 2 == 0) {
+            pending.push_back(SZ_compress_async(conf, fields[s].data(), [&cmpData, s](const char *data, size_t size) {
+                cmpData[s].assign(data, data + size);
+            }, [&consumed] { consumed++; }));
+        } else {
+            cmpData[s].resize(cmpCap);
+            pending.push_back(SZ_compress_async(conf, fields[s].data(), cmpData[s].data(), cmpCap,
+                                                [&consumed] { consumed++; }));
+        }
+    }
+
+    bool passed = true;
+    double max_err = 0;
+    for (size_t s = 0; s < steps; s++) {
+        size_t cmpSize = pending[s].get();
+        passed = passed && cmpSize <= cmpData[s].size();
+        SZ3::Config dec_conf;
+        std::vector<float> dec_data(conf.num);
+        SZ_decompress(dec_conf, cmpData[s].data(), cmpSize, dec_data.data(), {});
+        max_err = std::max(max_err, max_error(dec_data.data(), fields[s].data(), conf.num));
+    }
+    passed = passed && consumed == steps && max_err <= conf.absErrorBound;
+    printf("%-16s futures %zu max error %g %s\n", "async", steps, max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// the interior of a field with one layer of ghost cells is compressed and decompressed in place
+bool test_strides() {
+    size_t n0 = 30, n1 = 40, n2 = 50;
+    auto data = smooth_field(n0, n1, n2);
+    std::vector<size_t> strides = {(n1 + 2) * (n2 + 2), n2 + 2, 1};
+    size_t interior = strides[0] + strides[1] + 1;
+    std::vector<float> ghosted((n0 + 2) * strides[0], -1.0f);
+    for (size_t i = 0; i < n0; i++) {
+        for (size_t j = 0; j < n1; j++) {
+            std::copy_n(&data[(i * n1 + j) * n2], n2, &ghosted[interior + i * strides[0] + j * strides[1]]);
+        }
+    }
+    SZ3::Config conf(n0, n1, n2);
+    conf.absErrorBound = 1E-3;
+    size_t cmpCap = SZ_compress_bound<float>(conf);
+    std::vector<char> cmpData(cmpCap), cmpStrided(cmpCap);
+    size_t cmpSize = SZ_compress(conf, data.data(), cmpData.data(), cmpCap);
+    size_t cmpSizeStrided = SZ_compress(conf, ghosted.data() + interior, strides, cmpStrided.data(), cmpCap);
+    bool passed = cmpSize == cmpSizeStrided && memcmp(cmpData.data(), cmpStrided.data(), cmpSize) == 0;
+
+    // decompress into a buffer of sentinels, only the interior changes
+    SZ3::Config dec_conf;
+    std::vector<float> dec_data(data.size());
+    SZ_decompress(dec_conf, cmpData.data(), cmpSize, dec_data.data(), {});
+    std::vector<float> dec_ghosted(ghosted.size(), -7.0f);
+    SZ_decompress(dec_conf, cmpData.data(), cmpSize, dec_ghosted.data() + interior, strides);
+    for (size_t i = 0; i < n0 + 2; i++) {
+        for (size_t j = 0; j < n1 + 2; j++) {
+            for (size_t k = 0; k < n2 + 2; k++) {
+                float v = dec_ghosted[i * strides[0] + j * strides[1] + k];
+                bool ghost = i == 0 || j == 0 || k == 0 || i > n0 || j > n1 || k > n2;
+                passed = passed && (ghost ? v == -7.0f : v == dec_data[((i - 1) * n1 + j - 1) * n2 + k - 1]);
+            }
+        }
+    }
+    double max_err = max_error(dec_data.data(), data.data(), data.size());
+    passed = passed && max_err <= conf.absErrorBound;
+    printf("%-16s max error %g %s\n", "strides", max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// more OpenMP blocks than fit along the first dimension, the field is also cut along the others
+bool test_omp_blocks() {
+    size_t n0 = 4, n1 = 60, n2 = 70;
+    auto data = smooth_field(n0, n1, n2);
+    SZ3::Config conf(n0, n1, n2);
+    conf.absErrorBound = 1E-3;
+    conf.openmp = true;
+    conf.ompBlocks = 12;
+    size_t cmpSize;
+    char *cmpData = SZ_compress(conf, data.data(), cmpSize);
+    SZ3::Config dec_conf;
+    std::vector<float> dec_data(data.size());
+    auto dec_data_p = dec_data.data();
+    SZ_decompress(dec_conf, cmpData, cmpSize, dec_data_p);
+    delete[] cmpData;
+
+    double max_err = max_error(dec_data.data(), data.data(), data.size());
+    bool passed = dec_conf.openmp && max_err <= conf.absErrorBound;
+    printf("%-16s max error %g %s\n", "omp_blocks", max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// blocks compressed on 4 threads are decompressed on 1 and on 3
+bool test_omp_threads() {
+#ifdef _OPENMP
+    size_t n0 = 40, n1 = 50, n2 = 60;
+    auto data = smooth_field(n0, n1, n2);
+    SZ3::Config conf(n0, n1, n2);
+    conf.absErrorBound = 1E-3;
+    conf.openmp = true;
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    size_t cmpSize;
+    char *cmpData = SZ_compress(conf, data.data(), cmpSize);
+
+    double max_err = 0;
+    for (int dec_threads: {1, 3}) {
+        omp_set_num_threads(dec_threads);
+        SZ3::Config dec_conf;
+        std::vector<float> dec_data(data.size());
+        auto dec_data_p = dec_data.data();
+        SZ_decompress(dec_conf, cmpData, cmpSize, dec_data_p);
+        max_err = std::max(max_err, max_error(dec_data.data(), data.data(), data.size()));
+    }
+    omp_set_num_threads(threads);
+    delete[] cmpData;
+
+    bool passed = max_err <= conf.absErrorBound;
+    printf("%-16s max error %g %s\n", "omp_threads", max_err, passed ? "passed" : "failed");
+    return passed;
+#else
+    return true;
+#endif
+}
+
+// interpolation levels run on several threads give the same stream and the same values as on one
+bool test_omp_interp() {
+    size_t n0 = 60, n1 = 70, n2 = 80;
+    auto data = smooth_field(n0, n1, n2);
+    SZ3::Config conf(n0, n1, n2);
+    conf.cmprAlgo = SZ3::ALGO_INTERP;
+    conf.absErrorBound = 1E-3;
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    size_t cmpCap = SZ_compress_bound<float>(conf);
+    std::vector<char> cmpSerial(cmpCap), cmpParallel(cmpCap);
+    size_t cmpSize = SZ_compress(conf, data.data(), cmpSerial.data(), cmpCap);
+    conf.ompInterp = true;
+    size_t cmpSizeParallel = SZ_compress(conf, data.data(), cmpParallel.data(), cmpCap);
+    bool passed = cmpSize == cmpSizeParallel && memcmp(cmpSerial.data(), cmpParallel.data(), cmpSize) == 0;
+
+    std::vector<float> dec_serial(data.size()), dec_parallel(data.size());
+    SZ3::Config dec_conf;
+    SZ_decompress(dec_conf, cmpSerial.data(), cmpSize, dec_serial.data(), {});
+    dec_conf = SZ3::Config();
+    dec_conf.ompInterp = true;
+    SZ_decompress(dec_conf, cmpSerial.data(), cmpSize, dec_parallel.data(), {});
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+
+    double max_err = max_error(dec_parallel.data(), data.data(), data.size());
+    passed = passed && dec_serial == dec_parallel && max_err <= conf.absErrorBound;
+    printf("%-16s max error %g %s\n", "omp_interp", max_err, passed ? "passed" : "failed");
+    return passed;
+}
+
+// streams of testfloat_8_8_128.dat written by SZ3 3.2.0 with an absolute error bound of 1e-2,
+// with the Huffman trees as node arrays and the OpenMP blocks cut along the first dimension
+bool test_legacy(const std::string &dir) {
+    std::vector<float> original(8 * 8 * 128);
+    std::ifstream(dir + "/testfloat_8_8_128.dat", std::ios::binary).read((char *) original.data(),
+                                                                          original.size() * sizeof(float));
+    bool passed = true;
+    for (auto name: {"interp_lorenzo", "lorenzo_reg", "interp_omp"}) {
+        try {
+            passed &= legacy_decode(dir, name, original, 1E-2);
+        } catch (std::exception &e) {
+            printf("legacy %-14s %s failed\n", name, e.what());
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Huffman code lengths cut short or longer than 32 bits are rejected
+bool test_huffman_lengths() {
+    std::vector<int> bins(1000);
+    for (size_t i = 0; i < bins.size(); i++) {
+        bins[i] = static_cast<int>(i * i % 37);
+    }
+    SZ3::HuffmanEncoder<int> encoder;
+    encoder.preprocess_encode(bins, 0);
+    std::vector<SZ3::uchar> tree(encoder.size_bound(bins.size(), 0));
+    SZ3::uchar *c = tree.data();
+    encoder.save(c);
+    size_t treeSize = c - tree.data();
+    encoder.postprocess_encode();
 
+    auto load = [](const std::vector<SZ3::uchar> &bytes, size_t length) {
+        SZ3::HuffmanEncoder<int> decoder;
+        const SZ3::uchar *pos = bytes.data();
+        try {
+            decoder.load(pos, length);
+        } catch (std::invalid_argument &) {
+            return false;
+        }
+        return length == 0;
+    };
+    // the first code length follows the offset, the node count and the number of states
+    std::vector<SZ3::uchar> corrupted(tree);
+    corrupted[sizeof(int) + 2 * sizeof(int)] = 33;
+    bool passed = load(tree, treeSize) && !load(tree, treeSize - 1) && !load(corrupted, treeSize);
+    printf("%-16s %s\n", "huffman_lengths", passed ? "passed" : "failed");
+    return passed;
+}
+
+// nearly all bins are 0, the Huffman encoder switches to runs
+bool test_runs(const SZ3::Config &conf, const std::vector<float> &input_data) {
+    SZ3::Config c = conf;
+    c.cmprAlgo = SZ3::ALGO_INTERP;
+    c.absErrorBound = 1E-1;
+    bool passed = round_trip("run_length", c, input_data);
+
+    // a constant field with a noisy corner, the runs of 0 are broken by other bins
+    size_t n = 64;
+    std::vector<float> patched(n * n * n, 1.0f);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < n / 4; i++) {
+        for (size_t j = 0; j < n; j++) {
+            for (size_t k = 0; k < n / 4; k++) {
+                seed = seed * 1664525u + 1013904223u;
+                patched[(i * n + j) * n + k] += static_cast<float>(seed >> 8) / (1u << 24);
+            }
+        }
+    }
+    SZ3::Config p(n, n, n);
+    p.absErrorBound = 1E-3;
+    passed &= round_trip("run_patched", p, patched);
+    return passed;
+}
+
+// the lossless stage on zstd worker threads at another level than the default
+bool test_zstd(const SZ3::Config &conf, const std::vector<float> &input_data) {
+    SZ3::Config c = conf;
+    c.zstdLevel = 9;
+    c.zstdWorkers = 2;
+    return round_trip("zstd_workers", c, input_data);
+}
+
+// LOSSLESS_AUTO stores noise as is behind "SZ3B" and its length, and hands compressible bytes to zstd;
+// stored data with a cut or corrupted header is rejected
+bool test_lossless_auto() {
+    size_t n = 1 << 20;
+    std::vector<SZ3::uchar> noise(n), smooth(n);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        noise[i] = static_cast<SZ3::uchar>(seed >> 24);
+        smooth[i] = static_cast<SZ3::uchar>(i / 64 % 7);
+    }
+    SZ3::Lossless_zstd lossless;
+    lossless.set_params(3, 0, SZ3::LOSSLESS_AUTO);
+    std::vector<SZ3::uchar> stored(lossless.size_bound(n)), zstd(lossless.size_bound(n)), dec(n);
+    size_t storedSize = lossless.compress(noise.data(), n, stored.data(), stored.size());
+    size_t zstdSize = lossless.compress(smooth.data(), n, zstd.data(), zstd.size());
+    const SZ3::uchar zstd_magic[4] = {0x28, 0xB5, 0x2F, 0xFD};
+    bool passed = storedSize == n + 4 + sizeof(size_t) && memcmp(stored.data(), "SZ3B", 4) == 0 &&
+                  zstdSize < n && memcmp(zstd.data(), zstd_magic, 4) == 0;
+    passed = passed && lossless.decompress(stored.data(), storedSize, dec.data(), n) == n && dec == noise;
+    passed = passed && lossless.decompress(zstd.data(), zstdSize, dec.data(), n) == n && dec == smooth;
+
+    auto rejected = [&](std::vector<SZ3::uchar> bytes, size_t len) {
+        try {
+            lossless.decompress(bytes.data(), len, dec.data(), n);
+        } catch (std::invalid_argument &) {
+            return true;
+        }
+        return false;
+    };
+    std::vector<SZ3::uchar> corrupted(stored);
+    corrupted[3] = 'C';
+    passed = passed && rejected(stored, 6) && rejected(stored, storedSize - 1) && rejected(corrupted, storedSize);
+    printf("%-16s stored %zu zstd %zu %s\n", "lossless_auto", storedSize, zstdSize, passed ? "passed" : "failed");
+    return passed;
+}
+
+// more than 2^20 quantization bins, the Huffman stream is cut in segments decoded in parallel
+bool test_segments(const SZ3::Config &conf, const std::vector<float> &input_data) {
+    SZ3::Config c = conf;
+    c.cmprAlgo = SZ3::ALGO_INTERP;
+    bool passed = round_trip("interp", c, input_data);
+
+    // noise spreads the bins, the Huffman codes are written without runs
+    std::vector<float> noisy_data(input_data);
+    uint32_t seed = 1;
+    for (auto &v: noisy_data) {
+        seed = seed * 1664525u + 1013904223u;
+        v += static_cast<float>(seed >> 8) / (1u << 24) * 1E-2f;
+    }
+    c.cmprAlgo = SZ3::ALGO_LORENZO_REG;
+    passed &= round_trip("huffman", c, noisy_data);
+    return passed;
+}
+
+// the rANS coder on the field of main, and on a field too small to fill every interleaved stream evenly
+bool test_rans(const SZ3::Config &conf, const std::vector<float> &input_data) {
+    SZ3::Config c = conf;
+    c.encoder = SZ3::ENCODER_RANS;
+    bool passed = round_trip("rans", c, input_data);
+
+    SZ3::Config small(7, 9, 11);
+    small.encoder = SZ3::ENCODER_RANS;
+    small.absErrorBound = 1E-3;
+    passed &= round_trip("rans_small", small, smooth_field(7, 9, 11));
+    return passed;
+}
+
+int main(int argc, char **argv) {
+    std::string dir = argc > 1 ? argv[1] : SZ3_SMOKE_TEST_DIR;
 
     std::vector<size_t> dims({100, 200, 300});
     SZ3::Config conf({dims[0], dims[1], dims[2]});
@@ -16,7 +643,6 @@ int main(int argc, char **argv) {
 
 
     std::vector<float> input_data(conf.num);
-    std::vector<float> dec_data(conf.num);
     std::vector<size_t> stride({dims[1] * dims[2], dims[2], 1});
 
     for (size_t i = 0; i < dims[0]; ++i) {
@@ -30,22 +656,38 @@ int main(int argc, char **argv) {
         }
     }
 
-    std::vector<float> input_data_copy(input_data);
-    conf.openmp = true;
-    size_t cmpSize;
-    char *cmpData = SZ_compress(conf, input_data.data(), cmpSize);
-    auto dec_data_p = dec_data.data();
-    SZ_decompress(conf, cmpData, cmpSize, dec_data_p);
-
-    double max_err = 0.0;
-    for (size_t i = 0; i < conf.num; i++) {
-        if (fabs(dec_data[i] - input_data_copy[i]) > max_err) {
-            max_err = fabs(dec_data[i] - input_data_copy[i]);
-        }
+    bool passed = true;
+    {
+        SZ3::Config c = conf;
+        c.openmp = true;
+        passed &= round_trip("interp_lorenzo", c, input_data);
+    }
+    {
+        SZ3::Config c = conf;
+        c.cmprAlgo = SZ3::ALGO_LORENZO_REG;
+        passed &= round_trip("lorenzo_reg", c, input_data);
     }
-    printf("Smoke test %s", max_err <= conf.absErrorBound ? "passed" : "failed");
-//    printf("%lu ", conf.num);
-    return 0;
+
+    passed &= test_runs(conf, input_data);
+    passed &= test_segments(conf, input_data);
+    passed &= test_rans(conf, input_data);
+    passed &= test_zstd(conf, input_data);
+    passed &= test_lossless_auto();
+    passed &= test_capacity();
+    passed &= test_batch();
+    passed &= test_tiles();
+    passed &= test_levels();
+    passed &= test_async();
+    passed &= test_strides();
+    passed &= test_omp_blocks();
+    passed &= test_omp_threads();
+    passed &= test_omp_interp();
+    passed &= test_stream();
+    passed &= test_huffman_lengths();
+    passed &= test_legacy(dir);
+
+    printf("Smoke test %s\n", passed ? "passed" : "failed");
+    return passed ? 0 : 1;
 
 
 }